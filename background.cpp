@@ -0,0 +1,169 @@
+#include "algorithm"
+#include "atomic"
+#include "bit"
+#include "cmath"
+#include "future"
+#include "stdexcept"
+#include "string"
+
+#include "background.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+    constexpr std::uint64_t even_bits { 0x5555'5555'5555'5555 };
+
+    /* Counts of one contiguous range of sequences */
+    struct Counts
+    {
+        std::array<std::uint64_t, 4> bases {};
+        std::vector<std::uint64_t> contexts;
+    };
+
+    void count_contexts(const std::uint64_t* words, int length, int order,
+        std::vector<std::uint64_t>& counts)
+    {
+        // a histogram scatter, so this stays scalar; it walks the packed
+        // words a word at a time rather than re-reading one per base
+        std::uint32_t ctx {};
+        for (int i {}; i < length; i += 32) {
+            std::uint64_t word { words[i >> 5] };
+            int end { std::min(32, length - i) };
+            for (int j {}; j < end; ++j, word >>= 2) {
+                int base { static_cast<int>(word & 3) };
+                if (i + j >= order) {
+                    ++counts[(ctx << 2) | base];
+                }
+                ctx = Background::context(ctx, base, order);
+            }
+        }
+    }
+}
+
+Background::Background(std::span<const std::uint64_t> words,
+    std::span<const std::size_t> offsets, std::span<const int> lengths,
+    int order, unsigned num_threads)
+    : m_order { order }
+{
+    if (order < 0 || order > max_order) {
+        throw std::invalid_argument {
+            "background order must be in [0, " + std::to_string(max_order) + "]"
+        };
+    }
+
+    std::size_t table_size { std::size_t { 4 } << (2 * order) };
+    int num_sequences { static_cast<int>(lengths.size()) };
+    auto count = [&](int begin, int end, Counts& counts) {
+        for (int i { begin }; i < end; ++i) {
+            const std::uint64_t* seq { words.data() + offsets[i] };
+            count_bases(seq, lengths[i], counts.bases);
+            if (order) {
+                count_contexts(seq, lengths[i], order, counts.contexts);
+            }
+        }
+    };
+
+    std::size_t total {};
+    for (int length : lengths) {
+        total += length;
+    }
+
+    // one table per thread, not per chunk: at max_order a table is 32 MB
+    std::vector<Counts> partial {};
+    // thread startup outweighs counting a few million bases
+    if (total < (1 << 22) || num_threads == 1) {
+        partial.push_back({ {}, std::vector<std::uint64_t>(order ? table_size : 0) });
+        count(0, num_sequences, partial[0]);
+    } else {
+        ThreadPool pool { num_threads };
+        int num_workers { static_cast<int>(pool.size()) };
+        // more chunks than threads, so one slow range does not hold up the rest
+        int num_chunks { num_workers * 4 };
+        partial.resize(num_workers);
+        std::atomic<int> next {};
+        std::vector<std::future<void>> workers {};
+        for (auto& counts : partial) {
+            workers.push_back(pool.submit([&, table_size]() {
+                counts.contexts.assign(order ? table_size : 0, 0);
+                for (int c { next++ }; c < num_chunks; c = next++) {
+                    int begin { static_cast<int>(static_cast<long>(num_sequences) * c / num_chunks) };
+                    int end { static_cast<int>(static_cast<long>(num_sequences) * (c + 1) / num_chunks) };
+                    count(begin, end, counts);
+                }
+            }));
+        }
+        for (auto& worker : workers) {
+            worker.get();
+        }
+    }
+
+    m_contextCounts.assign(order ? table_size : 0, 0);
+    for (const auto& counts : partial) {
+        for (int b {}; b < 4; ++b) {
+            m_baseCounts[b] += counts.bases[b];
+        }
+        for (std::size_t i {}; i < counts.contexts.size(); ++i) {
+            m_contextCounts[i] += counts.contexts[i];
+        }
+    }
+
+    m_logConditional.resize(table_size);
+    if (!order) {
+        auto freqs { frequencies() };
+        for (int b {}; b < 4; ++b) {
+            m_logConditional[b] = std::log(freqs[b]);
+        }
+        return;
+    }
+    for (std::size_t ctx {}; ctx < table_size; ctx += 4) {
+        double total { 4.0 };
+        for (int b {}; b < 4; ++b) {
+            total += m_contextCounts[ctx + b];
+        }
+        for (int b {}; b < 4; ++b) {
+            m_logConditional[ctx + b] = std::log((m_contextCounts[ctx + b] + 1) / total);
+        }
+    }
+}
+
+std::array<double, 4> Background::frequencies() const
+{
+    double total { 4.0 };
+    for (auto count : m_baseCounts) {
+        total += count;
+    }
+
+    std::array<double, 4> result {};
+    for (int b {}; b < 4; ++b) {
+        result[b] = (m_baseCounts[b] + 1) / total;
+    }
+    return result;
+}
+
+void Background::count_bases(const std::uint64_t* words, int length,
+    std::array<std::uint64_t, 4>& counts)
+{
+    // a base's low and high bits are C (01), T (10) or G (11); every
+    // other base is A, which also fills any padding past length
+    std::uint64_t c {}, t {}, g {};
+    int full_words { length / 32 };
+    for (int w {}; w < full_words; ++w) {
+        std::uint64_t lo { words[w] & even_bits };
+        std::uint64_t hi { (words[w] >> 1) & even_bits };
+        c += std::popcount(lo & ~hi);
+        t += std::popcount(hi & ~lo);
+        g += std::popcount(lo & hi);
+    }
+    if (int tail { length % 32 }) {
+        std::uint64_t word { words[full_words] & ((std::uint64_t { 1 } << (2 * tail)) - 1) };
+        std::uint64_t lo { word & even_bits };
+        std::uint64_t hi { (word >> 1) & even_bits };
+        c += std::popcount(lo & ~hi);
+        t += std::popcount(hi & ~lo);
+        g += std::popcount(lo & hi);
+    }
+
+    counts[0] += length - c - t - g;
+    counts[1] += c;
+    counts[2] += t;
+    counts[3] += g;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "array"
+#include "cstddef"
+#include "cstdint"
+#include "span"
+#include "vector"
+
+/* Background nucleotide model of a whole dataset: exact base frequencies
+ * and, for order m > 0, the probability of each base given the m bases
+ * before it (an order-m Markov chain)
+ */
+class Background
+{
+    public:
+        /* Counts every sequence of packed storage laid out like Data's
+         * (sequence i is lengths[i] bases from word offsets[i]) in one pass
+         * num_threads : 0 uses one thread per hardware thread; small
+         * datasets are counted on the calling thread
+         */
+        Background(std::span<const std::uint64_t> words,
+            std::span<const std::size_t> offsets, std::span<const int> lengths,
+            int order = 0, unsigned num_threads = 0);
+
+        int order() const { return m_order; }
+
+        /* Occurrences of each base */
+        const std::array<std::uint64_t, 4>& base_counts() const { return m_baseCounts; }
+
+        /* Base frequencies, with one pseudocount each so no base has
+         * probability 0
+         */
+        std::array<double, 4> frequencies() const;
+
+        /* Occurrences of each (order+1)-mer, indexed by context() << 2 | base;
+         * empty for order 0
+         */
+        const std::vector<std::uint64_t>& context_counts() const { return m_contextCounts; }
+
+        /* log P(base | context) for every (order+1)-mer, indexed like
+         * context_counts(), with one pseudocount per entry; log frequencies()
+         * for order 0
+         */
+        const std::vector<double>& log_conditional() const { return m_logConditional; }
+
+        /* Rolls base into the order-base context ctx, whose most recent base
+         * is in the low bits
+         */
+        static std::uint32_t context(std::uint32_t ctx, int base, int order)
+        {
+            return ((ctx << 2) | base) & ((std::uint32_t { 1 } << (2 * order)) - 1);
+        }
+
+        /* Adds the bases of the length-nucleotide packed sequence at words
+         * to counts, a word at a time
+         */
+        static void count_bases(const std::uint64_t* words, int length,
+            std::array<std::uint64_t, 4>& counts);
+
+        /* Highest supported order; tables hold 4^(order+1) entries */
+        static constexpr int max_order { 10 };
+
+    private:
+        int m_order;
+        std::array<std::uint64_t, 4> m_baseCounts {};
+        std::vector<std::uint64_t> m_contextCounts;
+        std::vector<double> m_logConditional;
+};
@@ -0,0 +1,312 @@
+#include "algorithm"
+#include "chrono"
+#include "cmath"
+#include "cstdint"
+#include "fstream"
+#include "iostream"
+#include "numeric"
+#include "string"
+#include "type_traits"
+#include "vector"
+
+#include "convergence.hpp"
+#include "data.hpp"
+#include "kernels.hpp"
+#include "pwm.hpp"
+#include "rng.hpp"
+#include "serial.hpp"
+
+/* Microbenchmarks for the sampler hot paths, each timed in isolation.
+ * Every case is warmed up, then timed over several repetitions of a batch
+ * sized so one repetition takes about --min-ms; statistics are per call.
+ */
+namespace {
+    struct Options
+    {
+        int reps { 10 };
+        double min_ms { 5 };
+        bool quick {};
+        std::string filter {};
+        std::string csv_path {};
+        std::string json_path {};
+    };
+
+    struct Measurement
+    {
+        std::string name;
+        std::string type;
+        int k;
+        int length;
+        int num_sequences;
+        int reps;
+        long batch;
+        double mean_ns;
+        double median_ns;
+        double stddev_ns;
+        double min_ns;
+        double max_ns;
+    };
+
+    /* Keeps the compiler from discarding value */
+    template <typename V>
+    void keep(const V& value)
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    template <typename T>
+    const char* type_name()
+    {
+        if constexpr (std::is_same_v<T, float>) return "float";
+        else if constexpr (std::is_same_v<T, double>) return "double";
+        else return "long double";
+    }
+
+    const char* isa_name(kernels::Isa isa)
+    {
+        switch (isa) {
+            case kernels::Isa::avx512: return "avx512";
+            case kernels::Isa::avx2: return "avx2";
+            case kernels::Isa::scalar: break;
+        }
+        return "scalar";
+    }
+
+    /* Exposes GibbsSampler's hot paths */
+    template <typename T>
+    class Probe : public Serial<T>
+    {
+        public:
+            using Serial<T>::Serial;
+            using GibbsSampler<T>::init_positions;
+            using GibbsSampler<T>::init_pwm;
+            using GibbsSampler<T>::update_pwm;
+            using GibbsSampler<T>::update_counts;
+            using GibbsSampler<T>::score;
+            using GibbsSampler<T>::sample;
+    };
+
+    class Bench
+    {
+        public:
+            explicit Bench(const Options& options) : m_options { options } {}
+
+            /* Times op (one call per invocation) unless filtered out */
+            template <typename F>
+            void run(const std::string& name, const char* type, int k, int length,
+                int num_sequences, F&& op);
+
+            const std::vector<Measurement>& results() const { return m_results; }
+
+        private:
+            const Options m_options;
+            std::vector<Measurement> m_results;
+    };
+
+    template <typename F>
+    void Bench::run(const std::string& name, const char* type, int k, int length,
+        int num_sequences, F&& op)
+    {
+        if (!m_options.filter.empty() && name.find(m_options.filter) == std::string::npos) {
+            return;
+        }
+        using clock = std::chrono::steady_clock;
+        auto elapsed_ns = [](clock::time_point start) {
+            return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        };
+
+        // warmup doubles the batch until it takes min_ms
+        long batch { 1 };
+        while (true) {
+            auto start { clock::now() };
+            for (long i {}; i < batch; ++i) {
+                op();
+            }
+            if (elapsed_ns(start) >= m_options.min_ms * 1e6 || batch >= (1L << 30)) {
+                break;
+            }
+            batch *= 2;
+        }
+
+        std::vector<double> per_call(m_options.reps);
+        for (auto& t : per_call) {
+            auto start { clock::now() };
+            for (long i {}; i < batch; ++i) {
+                op();
+            }
+            t = elapsed_ns(start) / batch;
+        }
+
+        std::sort(begin(per_call), end(per_call));
+        int n { static_cast<int>(per_call.size()) };
+        double mean { std::accumulate(begin(per_call), end(per_call), 0.0) / n };
+        double var {};
+        for (double t : per_call) {
+            var += (t - mean) * (t - mean);
+        }
+        double median { n % 2 ? per_call[n/2] : (per_call[n/2 - 1] + per_call[n/2]) / 2 };
+
+        m_results.push_back({ name, type, k, length, num_sequences, n, batch, mean, median,
+            std::sqrt(var / std::max(n - 1, 1)), per_call.front(), per_call.back() });
+        const auto& m { m_results.back() };
+        std::cerr << name << " " << type << " k=" << k << " L=" << length
+                  << " N=" << num_sequences << ": " << m.median_ns << " ns\n";
+    }
+
+    template <typename T>
+    void bench_sampler(Bench& bench, const Data& data, int k, int length, int num_sequences)
+    {
+        const char* type { type_name<T>() };
+        Probe<T> probe { data, rng::Philox { 2 } };
+        std::vector<int> positions { probe.init_positions(k) };
+        Pwm<T> pwm { probe.init_pwm(positions, k, 0.1) };
+
+        bench.run("init_pwm", type, k, length, num_sequences, [&]() {
+            auto result { probe.init_pwm(positions, k, 0.1) };
+            keep(result);
+        });
+
+        int withheld {};
+        bench.run("score", type, k, length, num_sequences, [&]() {
+            keep(probe.score(pwm, withheld));
+            withheld = (withheld + 1) % num_sequences;
+        });
+
+        std::vector<T> scores { probe.score(pwm, withheld) };
+        bench.run("sample", type, k, length, num_sequences, [&]() {
+            keep(probe.sample(scores));
+        });
+
+        bench.run("update_pwm", type, k, length, num_sequences, [&]() {
+            int next { (withheld + 1) % num_sequences };
+            probe.update_pwm(pwm, positions, withheld, next);
+            withheld = next;
+        });
+
+        // a remove/add pair that moves one sequence's window, so log_odds
+        // has stale columns to recompute
+        bench.run("update_counts", type, k, length, num_sequences, [&]() {
+            int& position { positions[withheld] };
+            probe.update_counts(pwm, withheld, position, false);
+            position = (position + 1) % (data.packed(withheld).size() - k);
+            probe.update_counts(pwm, withheld, position);
+            keep(pwm.log_odds());
+        });
+
+        bench.run("consensus", type, k, length, num_sequences, [&]() {
+            keep(pwm.consensus());
+        });
+
+        ConsensusTracker<T> tracker { pwm };
+        bench.run("consensus_tracker", type, k, length, num_sequences, [&]() {
+            int next { (withheld + 1) % num_sequences };
+            probe.update_pwm(pwm, positions, withheld, next);
+            withheld = next;
+            keep(tracker.update(pwm));
+        });
+    }
+
+    void write_csv(std::ostream& os, const std::vector<Measurement>& results)
+    {
+        os << "benchmark,type,isa,k,L,N,reps,batch,mean_ns,median_ns,stddev_ns,min_ns,max_ns\n";
+        for (const auto& m : results) {
+            os << m.name << "," << m.type << "," << isa_name(kernels::detect_isa()) << ","
+               << m.k << "," << m.length << "," << m.num_sequences << "," << m.reps << ","
+               << m.batch << "," << m.mean_ns << "," << m.median_ns << "," << m.stddev_ns << ","
+               << m.min_ns << "," << m.max_ns << "\n";
+        }
+    }
+
+    void write_json(std::ostream& os, const std::vector<Measurement>& results)
+    {
+        os << "{\"isa\": \"" << isa_name(kernels::detect_isa()) << "\", \"results\": [\n";
+        for (std::size_t i {}; i < results.size(); ++i) {
+            const auto& m { results[i] };
+            os << "  {\"benchmark\": \"" << m.name << "\", \"type\": \"" << m.type
+               << "\", \"k\": " << m.k << ", \"L\": " << m.length << ", \"N\": " << m.num_sequences
+               << ", \"reps\": " << m.reps << ", \"batch\": " << m.batch
+               << ", \"mean_ns\": " << m.mean_ns << ", \"median_ns\": " << m.median_ns
+               << ", \"stddev_ns\": " << m.stddev_ns << ", \"min_ns\": " << m.min_ns
+               << ", \"max_ns\": " << m.max_ns << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        os << "]}\n";
+    }
+
+    bool parse(int argc, char* argv[], Options& options)
+    {
+        for (int i { 1 }; i < argc; ++i) {
+            std::string arg { argv[i] };
+            bool has_value { i + 1 < argc };
+            if (arg == "--reps" && has_value) {
+                options.reps = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--min-ms" && has_value) {
+                options.min_ms = std::stod(argv[++i]);
+            } else if (arg == "--filter" && has_value) {
+                options.filter = argv[++i];
+            } else if (arg == "--csv" && has_value) {
+                options.csv_path = argv[++i];
+            } else if (arg == "--json" && has_value) {
+                options.json_path = argv[++i];
+            } else if (arg == "--quick") {
+                options.quick = true;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options {};
+    if (!parse(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--reps <n>] [--min-ms <ms>] [--filter <name>] "
+                  << "[--quick] [--csv <path>] [--json <path>]\n"
+                  << "Writes CSV to stdout unless --csv or --json is given\n";
+        return 1;
+    }
+
+    std::vector<int> ks { 8, 16, 24 };
+    std::vector<int> lengths { 1'000, 10'000, 100'000 };
+    std::vector<int> counts { 16, 256 };
+    if (options.quick) {
+        ks = { 8, 16 };
+        lengths = { 1'000, 10'000 };
+        counts = { 16 };
+    }
+
+    Bench bench { options };
+    for (int num_sequences : counts) {
+        for (int length : lengths) {
+            if (static_cast<long>(num_sequences) * length > 10'000'000) {
+                continue;
+            }
+            bench.run("data", "-", 0, length, num_sequences, [&]() {
+                Data data { { 16 }, num_sequences, length, rng::Philox { 1 } };
+                keep(data);
+            });
+
+            Data data { { 16 }, num_sequences, length, rng::Philox { 1 } };
+            for (int k : ks) {
+                bench_sampler<float>(bench, data, k, length, num_sequences);
+                bench_sampler<double>(bench, data, k, length, num_sequences);
+                bench_sampler<long double>(bench, data, k, length, num_sequences);
+            }
+        }
+    }
+
+    if (!options.csv_path.empty()) {
+        std::ofstream csv { options.csv_path };
+        write_csv(csv, bench.results());
+    }
+    if (!options.json_path.empty()) {
+        std::ofstream json { options.json_path };
+        write_json(json, bench.results());
+    }
+    if (options.csv_path.empty() && options.json_path.empty()) {
+        write_csv(std::cout, bench.results());
+    }
+
+    return 0;
+}
@@ -0,0 +1,268 @@
+#include "algorithm"
+#include "cstring"
+#include "stdexcept"
+#include "string"
+#include "vector"
+
+#include "fcntl.h"
+#include "unistd.h"
+
+#include "block_store.hpp"
+#include "fasta.hpp"
+#include "mapped_file.hpp"
+
+Block::Block(const block_format::BlockEntry& entry, std::vector<std::uint64_t>&& buffer)
+    : m_entry { entry },
+      m_buffer { std::move(buffer) }
+{
+    const auto* bytes { reinterpret_cast<const char*>(m_buffer.data()) };
+    m_sequences = reinterpret_cast<const block_format::SequenceEntry*>(bytes);
+    bytes += sizeof(block_format::SequenceEntry) * m_entry.num_sequences;
+    m_motifs = reinterpret_cast<const block_format::MotifEntry*>(bytes);
+    bytes += sizeof(block_format::MotifEntry) * m_entry.num_motifs;
+    m_words = reinterpret_cast<const std::uint64_t*>(bytes);
+}
+
+PackedSequence Block::sequence(std::size_t i) const
+{
+    const auto& entry { m_sequences[i] };
+    return { m_words + entry.word_offset, static_cast<int>(entry.length) };
+}
+
+std::span<const block_format::MotifEntry> Block::motifs(std::size_t i) const
+{
+    const auto& entry { m_sequences[i] };
+    return { m_motifs + entry.motif_offset, entry.num_motifs };
+}
+
+BlockStore::BlockStore(const std::string& path)
+    : m_fd { ::open(path.c_str(), O_RDONLY) },
+      m_header {}
+{
+    if (m_fd < 0) {
+        throw std::runtime_error { "cannot open " + path };
+    }
+
+    // the destructor does not run if the constructor throws
+    try {
+        read_at(&m_header, sizeof(m_header), 0);
+        if (std::memcmp(m_header.magic, block_format::magic, sizeof(m_header.magic)) != 0 ||
+            m_header.version != block_format::version) {
+            throw std::runtime_error { path + " is not a block store" };
+        }
+
+        m_index.resize(m_header.num_blocks);
+        read_at(m_index.data(), sizeof(block_format::BlockEntry) * m_index.size(), 
+            m_header.index_offset);
+
+        std::uint64_t num_motifs {};
+        std::size_t offset { m_header.motifs_offset };
+        read_at(&num_motifs, sizeof(num_motifs), offset);
+        offset += sizeof(num_motifs);
+        for (std::uint64_t i {}; i < num_motifs; ++i) {
+            std::uint64_t length {};
+            read_at(&length, sizeof(length), offset);
+            offset += sizeof(length);
+
+            std::string motif(length, ' ');
+            read_at(motif.data(), length, offset);
+            offset += (length + 7) / 8 * 8;
+            m_motifs.push_back(std::move(motif));
+        }
+    } catch (...) {
+        ::close(m_fd);
+        throw;
+    }
+}
+
+BlockStore::~BlockStore()
+{
+    ::close(m_fd);
+}
+
+std::size_t BlockStore::max_block_bytes() const
+{
+    std::size_t result {};
+    for (const auto& entry : m_index) {
+        result = std::max<std::size_t>(result, entry.bytes);
+    }
+    return result;
+}
+
+void BlockStore::read_at(void* out, std::size_t bytes, std::size_t offset) const
+{
+    auto* dest { static_cast<char*>(out) };
+    while (bytes > 0) {
+        ssize_t count { ::pread(m_fd, dest, bytes, offset) };
+        if (count <= 0) {
+            throw std::runtime_error { "truncated block store" };
+        }
+        dest += count;
+        bytes -= count;
+        offset += count;
+    }
+}
+
+Block BlockStore::read_block(std::size_t b) const
+{
+    const auto& entry { m_index[b] };
+    std::vector<std::uint64_t> buffer(entry.bytes / sizeof(std::uint64_t));
+    read_at(buffer.data(), entry.bytes, entry.offset);
+    return { entry, std::move(buffer) };
+}
+
+void BlockStore::write(const Data& data, const std::string& path, 
+    std::size_t block_bytes)
+{
+    std::vector<std::string> motifs {};
+    for (const auto& seq : data.sequences()) {
+        for (const auto& motif : seq.m_motifs) {
+            if (motif.m_motifId >= static_cast<int>(motifs.size())) {
+                motifs.resize(motif.m_motifId + 1);
+            }
+            motifs[motif.m_motifId] = motif.m_baseMotif;
+        }
+    }
+
+    BlockWriter writer { path, block_bytes, motifs };
+    for (int i {}; i < data.size().first; ++i) {
+        writer.add(data.packed(i), data.sequences()[i].m_motifs);
+    }
+    writer.close();
+}
+
+void BlockStore::write_fasta(const std::string& fasta_path, 
+    const std::string& path, std::size_t block_bytes)
+{
+    MappedFile file { fasta_path };
+    const char* file_begin { file.data() };
+    const char* file_end { file_begin + file.size() };
+
+    BlockWriter writer { path, block_bytes };
+    std::vector<std::uint64_t> words {};
+    const char* pos { fasta::next_record(file_begin, file_begin, file_end) };
+    while (pos < file_end) {
+        auto record { fasta::read_record(file_begin, pos, file_end) };
+        words.assign((static_cast<std::size_t>(record.length) + 31) / 32, 0);
+        fasta::pack_record(record, words.data());
+        writer.add({ words.data(), record.length });
+        pos = record.body_end;
+    }
+    writer.close();
+}
+
+BlockWriter::BlockWriter(const std::string& path, std::size_t block_bytes,
+    const std::vector<std::string>& motifs)
+    : m_out { path, std::ios::binary | std::ios::trunc },
+      m_path { path },
+      m_blockBytes { block_bytes },
+      m_baseMotifs { motifs }
+{
+    if (!m_out) {
+        throw std::runtime_error { "cannot write " + path };
+    }
+    std::memcpy(m_header.magic, block_format::magic, sizeof(m_header.magic));
+    m_header.version = block_format::version;
+    m_out.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+}
+
+BlockWriter::~BlockWriter()
+{
+    if (!m_closed) {
+        // a destructor cannot throw; call close() to see write errors
+        try {
+            close();
+        } catch (const std::runtime_error&) {
+        }
+    }
+}
+
+std::size_t BlockWriter::pending_bytes() const
+{
+    return sizeof(block_format::SequenceEntry) * m_sequences.size() +
+        sizeof(block_format::MotifEntry) * m_motifs.size() +
+        sizeof(std::uint64_t) * m_words.size();
+}
+
+void BlockWriter::add(const PackedSequence& sequence, const std::vector<Motif>& motifs)
+{
+    std::size_t num_words { (static_cast<std::size_t>(sequence.size()) + 31) / 32 };
+    m_sequences.push_back({
+        .word_offset = m_words.size(),
+        .length = static_cast<std::uint32_t>(sequence.size()),
+        .num_motifs = static_cast<std::uint32_t>(motifs.size()),
+        .motif_offset = m_motifs.size()
+    });
+    m_words.insert(end(m_words), sequence.words(), sequence.words() + num_words);
+    for (const auto& motif : motifs) {
+        m_motifs.push_back({ motif.m_startingIndex, motif.m_motifId });
+    }
+
+    ++m_header.num_sequences;
+    m_header.max_length = std::max<std::uint64_t>(m_header.max_length, sequence.size());
+    if (pending_bytes() >= m_blockBytes) {
+        flush();
+    }
+}
+
+void BlockWriter::flush()
+{
+    if (m_sequences.empty()) {
+        return;
+    }
+
+    m_index.push_back({
+        .offset = static_cast<std::uint64_t>(m_out.tellp()),
+        .bytes = pending_bytes(),
+        .first_sequence = m_header.num_sequences - m_sequences.size(),
+        .num_sequences = m_sequences.size(),
+        .num_motifs = m_motifs.size()
+    });
+    m_out.write(reinterpret_cast<const char*>(m_sequences.data()), 
+        sizeof(block_format::SequenceEntry) * m_sequences.size());
+    m_out.write(reinterpret_cast<const char*>(m_motifs.data()), 
+        sizeof(block_format::MotifEntry) * m_motifs.size());
+    m_out.write(reinterpret_cast<const char*>(m_words.data()), 
+        sizeof(std::uint64_t) * m_words.size());
+
+    m_sequences.clear();
+    m_motifs.clear();
+    m_words.clear();
+    check();
+}
+
+void BlockWriter::check()
+{
+    if (!m_out) {
+        m_closed = true;
+        throw std::runtime_error { "error writing " + m_path };
+    }
+}
+
+void BlockWriter::close()
+{
+    flush();
+
+    // motif entries are 8 bytes, so every block ends 8-byte aligned
+    m_header.motifs_offset = m_out.tellp();
+    std::uint64_t num_motifs { m_baseMotifs.size() };
+    m_out.write(reinterpret_cast<const char*>(&num_motifs), sizeof(num_motifs));
+    for (const auto& motif : m_baseMotifs) {
+        std::uint64_t length { motif.size() };
+        std::string padded { motif };
+        padded.resize((length + 7) / 8 * 8, '\0');
+        m_out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        m_out.write(padded.data(), padded.size());
+    }
+
+    m_header.index_offset = m_out.tellp();
+    m_header.num_blocks = m_index.size();
+    m_out.write(reinterpret_cast<const char*>(m_index.data()), 
+        sizeof(block_format::BlockEntry) * m_index.size());
+
+    m_out.seekp(0);
+    m_out.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    m_out.close();
+    check();
+    m_closed = true;
+}
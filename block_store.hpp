@@ -0,0 +1,181 @@
+#pragma once
+
+#include "cstddef"
+#include "cstdint"
+#include "fstream"
+#include "span"
+#include "string"
+#include "vector"
+
+#include "data.hpp"
+
+/* On-disk layout of a block store: a dataset split into independently 
+ * readable blocks of 2-bit packed sequences with their ground-truth motifs.
+ * Every structure is 8-byte aligned so blocks can be used in place.
+ *
+ * FileHeader | block 0 | block 1 | ... | motif table | BlockEntry index
+ * block : SequenceEntry[num_sequences] | MotifEntry[num_motifs] | words
+ * motif table : u64 count | (u64 length | chars padded to 8 bytes) per motif
+ */
+namespace block_format {
+    inline constexpr char magic[8] { 'M', 'O', 'T', 'I', 'F', 'B', 'L', 'K' };
+    inline constexpr std::uint32_t version { 1 };
+
+    struct FileHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t reserved;
+        std::uint64_t num_sequences;
+        std::uint64_t num_blocks;
+        std::uint64_t max_length;
+        std::uint64_t index_offset;
+        std::uint64_t motifs_offset;
+    };
+
+    struct BlockEntry
+    {
+        std::uint64_t offset;
+        std::uint64_t bytes;
+        std::uint64_t first_sequence;
+        std::uint64_t num_sequences;
+        std::uint64_t num_motifs;
+    };
+
+    struct SequenceEntry
+    {
+        /* Relative to the first word of the block */
+        std::uint64_t word_offset;
+        std::uint32_t length;
+        std::uint32_t num_motifs;
+
+        /* Index of the first MotifEntry of the sequence within the block */
+        std::uint64_t motif_offset;
+    };
+
+    struct MotifEntry
+    {
+        std::int32_t start;
+        std::int32_t id;
+    };
+}
+
+/* One block of a BlockStore held in memory */
+class Block
+{
+    public:
+        Block() = default;
+        Block(const block_format::BlockEntry& entry, std::vector<std::uint64_t>&& buffer);
+
+        std::size_t first_sequence() const { return m_entry.first_sequence; }
+        std::size_t num_sequences() const { return m_entry.num_sequences; }
+        std::size_t bytes() const { return m_entry.bytes; }
+
+        /* i is relative to first_sequence() */
+        PackedSequence sequence(std::size_t i) const;
+        std::span<const block_format::MotifEntry> motifs(std::size_t i) const;
+
+    private:
+        block_format::BlockEntry m_entry {};
+        std::vector<std::uint64_t> m_buffer {};
+        const block_format::SequenceEntry* m_sequences {};
+        const block_format::MotifEntry* m_motifs {};
+        const std::uint64_t* m_words {};
+};
+
+/* Read-only access to a block store file; blocks are read on demand so
+ * only the blocks a caller holds occupy memory. read_block may be called
+ * concurrently.
+ */
+class BlockStore
+{
+    public:
+        /* Throws std::runtime_error if path is not a readable block store */
+        explicit BlockStore(const std::string& path);
+        ~BlockStore();
+
+        BlockStore(const BlockStore&) = delete;
+        BlockStore& operator=(const BlockStore&) = delete;
+
+        std::size_t num_sequences() const { return m_header.num_sequences; }
+        std::size_t num_blocks() const { return m_index.size(); }
+        int max_length() const { return m_header.max_length; }
+
+        /* Size in bytes of the largest block */
+        std::size_t max_block_bytes() const;
+
+        /* Base motifs embedded in the sequences, indexed by motif id */
+        const std::vector<std::string>& motifs() const { return m_motifs; }
+
+        const std::vector<block_format::BlockEntry>& index() const { return m_index; }
+
+        Block read_block(std::size_t b) const;
+
+        /* Writes every sequence (and motif) of data to path
+         * block_bytes : target size of a block; a block holds at least one
+         * sequence
+         */
+        static void write(const Data& data, const std::string& path, 
+            std::size_t block_bytes = 64 << 20);
+
+        /* Converts a FASTA file to a block store one record at a time, so the
+         * dataset never has to fit in memory
+         */
+        static void write_fasta(const std::string& fasta_path, 
+            const std::string& path, std::size_t block_bytes = 64 << 20);
+
+    private:
+        int m_fd;
+        block_format::FileHeader m_header;
+        std::vector<block_format::BlockEntry> m_index;
+        std::vector<std::string> m_motifs;
+
+        void read_at(void* out, std::size_t bytes, std::size_t offset) const;
+};
+
+/* Appends sequences to a new block store, flushing a block whenever it
+ * reaches the target size
+ */
+class BlockWriter
+{
+    public:
+        /* motifs : base motifs referenced by the MotifEntry ids */
+        BlockWriter(const std::string& path, std::size_t block_bytes, 
+            const std::vector<std::string>& motifs = {});
+
+        /* Calls close() if it has not been called yet, ignoring errors */
+        ~BlockWriter();
+
+        BlockWriter(const BlockWriter&) = delete;
+        BlockWriter& operator=(const BlockWriter&) = delete;
+
+        void add(const PackedSequence& sequence, const std::vector<Motif>& motifs = {});
+
+        /* Flushes the last block and writes the motif table, index and header
+         * Throws std::runtime_error if any write failed, e.g. on a full disk
+         */
+        void close();
+
+    private:
+        std::ofstream m_out;
+        const std::string m_path;
+        const std::size_t m_blockBytes;
+        const std::vector<std::string> m_baseMotifs;
+
+        block_format::FileHeader m_header {};
+        std::vector<block_format::BlockEntry> m_index {};
+
+        /* Pending block */
+        std::vector<block_format::SequenceEntry> m_sequences {};
+        std::vector<block_format::MotifEntry> m_motifs {};
+        std::vector<std::uint64_t> m_words {};
+        bool m_closed {};
+
+        std::size_t pending_bytes() const;
+        void flush();
+
+        /* Throws if a write has failed, so add() stops at the first block
+         * that did not fit
+         */
+        void check();
+};
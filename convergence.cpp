@@ -0,0 +1,88 @@
+#include "algorithm"
+#include "limits"
+
+#include "convergence.hpp"
+
+FixedIterations::FixedIterations(int max_iters)
+    : m_maxIters { max_iters }
+{
+}
+
+std::unique_ptr<StoppingPolicy> FixedIterations::clone() const
+{
+    return std::make_unique<FixedIterations>(*this);
+}
+
+bool FixedIterations::stop(const Progress& progress)
+{
+    return progress.iteration >= m_maxIters;
+}
+
+StableConsensus::StableConsensus(int window, int max_iters)
+    : m_window { window },
+      m_maxIters { max_iters }
+{
+}
+
+std::unique_ptr<StoppingPolicy> StableConsensus::clone() const
+{
+    return std::make_unique<StableConsensus>(*this);
+}
+
+void StableConsensus::reset()
+{
+    m_converged = false;
+}
+
+bool StableConsensus::stop(const Progress& progress)
+{
+    m_converged = progress.stable_iterations >= m_window;
+    return m_converged || progress.iteration >= m_maxIters;
+}
+
+LikelihoodPlateau::LikelihoodPlateau(int patience, double tolerance,
+    int max_iters)
+    : m_patience { patience },
+      m_tolerance { tolerance },
+      m_maxIters { max_iters },
+      m_best { -std::numeric_limits<double>::infinity() }
+{
+}
+
+std::unique_ptr<StoppingPolicy> LikelihoodPlateau::clone() const
+{
+    return std::make_unique<LikelihoodPlateau>(*this);
+}
+
+void LikelihoodPlateau::reset()
+{
+    m_best = -std::numeric_limits<double>::infinity();
+    m_stale = 0;
+    m_converged = false;
+}
+
+bool LikelihoodPlateau::stop(const Progress& progress)
+{
+    if (progress.iteration % std::max(progress.num_sequences, 1) == 0) {
+        double log_likelihood { progress.log_likelihood() };
+        if (log_likelihood > m_best + m_tolerance) {
+            m_best = log_likelihood;
+            m_stale = 0;
+        } else {
+            ++m_stale;
+        }
+        m_converged = m_stale >= m_patience;
+    }
+    return m_converged || progress.iteration >= m_maxIters;
+}
+
+Restarts::Restarts(const StoppingPolicy& policy, int rounds)
+    : m_policy { policy.clone() },
+      m_rounds { rounds }
+{
+}
+
+std::unique_ptr<StoppingPolicy> Restarts::clone() const
+{
+    return std::make_unique<Restarts>(*m_policy, m_rounds);
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "cstdint"
+#include "functional"
+#include "memory"
+#include "string"
+
+#include "pwm.hpp"
+#include "utility.hpp"
+
+/* Keeps the consensus of a Pwm up to date by re-taking the argmax of only
+ * the columns whose counts changed since the previous update
+ */
+template <typename T>
+class ConsensusTracker
+{
+    public:
+        explicit ConsensusTracker(const Pwm<T>& pwm)
+            : m_consensus { pwm.consensus() },
+              m_version { pwm.version() }
+        {
+        }
+
+        /* Returns true if any consensus letter changed */
+        bool update(const Pwm<T>& pwm);
+
+        const std::string& consensus() const { return m_consensus; }
+
+    private:
+        std::string m_consensus;
+        std::uint64_t m_version;
+};
+
+template <typename T>
+bool ConsensusTracker<T>::update(const Pwm<T>& pwm)
+{
+    bool changed {};
+    for (int i {}; i < pwm.k(); ++i) {
+        if (pwm.changed_since(i, m_version)) {
+            char base { utility::decode(pwm.argmax(i)) };
+            changed |= base != m_consensus[i];
+            m_consensus[i] = base;
+        }
+    }
+    m_version = pwm.version();
+    return changed;
+}
+
+/* What a sampler reports to its StoppingPolicy after every iteration */
+struct Progress
+{
+    /* Iterations completed in the current round */
+    int iteration {};
+
+    /* Consecutive iterations without a change to the consensus */
+    int stable_iterations {};
+
+    int num_sequences {};
+
+    /* Computes the log-likelihood of the current positions; O(N * k) */
+    std::function<double()> log_likelihood {};
+};
+
+/* Decides when a chain stops. Policies are stateful, so each chain owns its
+ * own clone, and reset() is called at the start of every round.
+ */
+class StoppingPolicy
+{
+    public:
+        virtual ~StoppingPolicy() = default;
+
+        virtual std::unique_ptr<StoppingPolicy> clone() const = 0;
+
+        virtual void reset() {}
+
+        /* Returns true once the chain should stop */
+        virtual bool stop(const Progress& progress) = 0;
+
+        /* True if the last stop() was due to convergence rather than the
+         * iteration limit
+         */
+        virtual bool converged() const { return false; }
+
+        /* Number of independent rounds (restarts) to run */
+        virtual int rounds() const { return 1; }
+};
+
+/* Runs exactly max_iters iterations */
+class FixedIterations : public StoppingPolicy
+{
+    public:
+        explicit FixedIterations(int max_iters = 10'000);
+
+        std::unique_ptr<StoppingPolicy> clone() const override;
+        bool stop(const Progress& progress) override;
+
+    private:
+        const int m_maxIters;
+};
+
+/* Converges once the consensus is unchanged for window iterations */
+class StableConsensus : public StoppingPolicy
+{
+    public:
+        explicit StableConsensus(int window = 200, int max_iters = 10'000);
+
+        std::unique_ptr<StoppingPolicy> clone() const override;
+        void reset() override;
+        bool stop(const Progress& progress) override;
+        bool converged() const override { return m_converged; }
+
+    private:
+        const int m_window;
+        const int m_maxIters;
+        bool m_converged {};
+};
+
+/* Checks the log-likelihood once per sweep (num_sequences iterations) and
+ * converges once it has not improved by more than tolerance for patience
+ * sweeps in a row
+ */
+class LikelihoodPlateau : public StoppingPolicy
+{
+    public:
+        explicit LikelihoodPlateau(int patience = 5, double tolerance = 1e-3,
+            int max_iters = 10'000);
+
+        std::unique_ptr<StoppingPolicy> clone() const override;
+        void reset() override;
+        bool stop(const Progress& progress) override;
+        bool converged() const override { return m_converged; }
+
+    private:
+        const int m_patience;
+        const double m_tolerance;
+        const int m_maxIters;
+
+        double m_best;
+        int m_stale {};
+        bool m_converged {};
+};
+
+/* Runs policy for the given number of rounds, each from fresh random
+ * positions; the sampler keeps the most likely round
+ */
+class Restarts : public StoppingPolicy
+{
+    public:
+        Restarts(const StoppingPolicy& policy, int rounds);
+
+        std::unique_ptr<StoppingPolicy> clone() const override;
+        void reset() override { m_policy->reset(); }
+        bool stop(const Progress& progress) override { return m_policy->stop(progress); }
+        bool converged() const override { return m_policy->converged(); }
+        int rounds() const override { return m_rounds; }
+
+    private:
+        std::unique_ptr<StoppingPolicy> m_policy;
+        const int m_rounds;
+};
@@ -1,14 +1,21 @@
 #include "algorithm"
+#include "cstring"
+#include "fstream"
 #include "iostream"
-#include "random"
+#include "numeric"
 #include "ranges"
 #include "set"
 #include "string"
+#include "stdexcept"
 #include "unordered_map"
 #include "utility"
 #include "vector"
 
 #include "data.hpp"
+#include "data_cache.hpp"
+#include "fasta.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
 #include "utility.hpp"
 
 #include "iostream"
@@ -16,16 +23,86 @@
 Data::Data(
     const std::vector<int>& motif_lengths, 
     int num_sequences,
-    int sequence_length
+    int sequence_length,
+    rng::Philox gen,
+    double mutation_rate,
+    unsigned num_threads
 ) : m_numSequences { num_sequences },
     m_sequenceLength { sequence_length }, 
     m_motifLengths { motif_lengths }, 
+    m_mutationRate { mutation_rate },
+    m_gen { gen },
     m_motifs { generate_motifs() }
 {
-    m_sequences.resize(m_numSequences);
-    std::generate(begin(m_sequences), end(m_sequences), [this]() {
-        return this->generate_sequence();
-    });
+    std::size_t words_per_sequence { (static_cast<std::size_t>(sequence_length) + 31) / 32 };
+    m_sequences.resize(num_sequences);
+    m_lengths.assign(num_sequences, sequence_length);
+    m_packedOffsets.resize(num_sequences);
+    for (int i {}; i < num_sequences; ++i) {
+        m_packedOffsets[i] = i * words_per_sequence;
+    }
+    m_packed.resize(num_sequences * words_per_sequence);
+    m_wordsView = m_packed;
+    m_offsetsView = m_packedOffsets;
+    m_lengthsView = m_lengths;
+
+    auto generate = [this](int begin, int end) {
+        for (int i { begin }; i < end; ++i) {
+            generate_sequence(i, m_gen.split(i));
+        }
+    };
+
+    // thread startup outweighs generating a few million bases
+    if (static_cast<std::size_t>(num_sequences) * sequence_length < (1 << 22) || num_threads == 1) {
+        generate(0, num_sequences);
+        return;
+    }
+
+    ThreadPool pool { num_threads };
+    int num_chunks { static_cast<int>(pool.size()) * 4 };
+    std::vector<std::future<void>> chunks {};
+    for (int c {}; c < num_chunks; ++c) {
+        int begin { static_cast<int>(static_cast<long>(num_sequences) * c / num_chunks) };
+        int end { static_cast<int>(static_cast<long>(num_sequences) * (c + 1) / num_chunks) };
+        chunks.push_back(pool.submit([&generate, begin, end]() { generate(begin, end); }));
+    }
+    for (auto& chunk : chunks) {
+        chunk.get();
+    }
+}
+
+Data::Data(const std::string& path, unsigned num_threads)
+    : Data(load(path, num_threads))
+{
+}
+
+Data::~Data() = default;
+
+Data::Data(Loaded&& loaded)
+    : m_numSequences { static_cast<int>(loaded.sequences.size()) },
+      m_sequenceLength { [&loaded]() {
+          auto lengths { loaded.mapping ? loaded.mapped_lengths : std::span<const int> { loaded.lengths } };
+          return lengths.empty() ? 0 : *std::max_element(begin(lengths), end(lengths));
+      }() },
+      m_motifLengths { [&loaded]() {
+          std::vector<int> lengths {};
+          for (const auto& motif : loaded.motifs) {
+              lengths.push_back(motif.size());
+          }
+          return lengths;
+      }() },
+      m_mutationRate {},
+      m_gen { rng::stream(rng::data_stream) },
+      m_motifs { std::move(loaded.motifs) },
+      m_sequences { std::move(loaded.sequences) },
+      m_packed { std::move(loaded.packed) },
+      m_packedOffsets { std::move(loaded.offsets) },
+      m_lengths { std::move(loaded.lengths) },
+      m_mapping { std::move(loaded.mapping) },
+      m_wordsView { m_mapping ? loaded.mapped_words : std::span<const std::uint64_t> { m_packed } },
+      m_offsetsView { m_mapping ? loaded.mapped_offsets : std::span<const std::size_t> { m_packedOffsets } },
+      m_lengthsView { m_mapping ? loaded.mapped_lengths : std::span<const int> { m_lengths } }
+{
 }
 
 const std::vector<Sequence>& Data::sequences() const
@@ -33,6 +110,23 @@ const std::vector<Sequence>& Data::sequences() const
     return m_sequences;
 }
 
+PackedSequence Data::packed(int i) const
+{
+    return { m_wordsView.data() + m_offsetsView[i], m_lengthsView[i] };
+}
+
+const Background& Data::background(int order) const
+{
+    // callers asking for the same order wait for the one count of it
+    std::lock_guard lock { m_backgroundMutex };
+    auto& model { m_backgrounds[order] };
+    if (!model) {
+        model = std::make_unique<const Background>(m_wordsView, m_offsetsView,
+            m_lengthsView, order);
+    }
+    return *model;
+}
+
 const std::pair<int, int> Data::size() const
 {
     return { m_numSequences, m_sequenceLength };
@@ -54,7 +148,7 @@ std::ostream& operator<<(std::ostream& os, const Data& obj)
         	return std::to_string(m.m_startingIndex);
 		});
 		std::string motif_indices {
-			std::accumulate(
+			seq.m_motifs.empty() ? "" : std::accumulate(
 				std::next(begin(indices)), end(indices), *begin(indices),
 				[](const std::string& a, const std::string& b) {
 		        	return a + ", " + b;
@@ -62,8 +156,14 @@ std::ostream& operator<<(std::ostream& os, const Data& obj)
 		};
 		os << "> sequence " << (count + 1) << " | motif indices: " << motif_indices << '\n';
 
-		for (int i {}; i < seq.m_sequence.length(); i+=80) {
-            os << seq.m_sequence.substr(i, 100) << "\n";
+		// decoded from packed storage, as loaded sequences keep no string
+		const auto packed { obj.packed(count) };
+		std::string sequence(packed.size(), ' ');
+		for (int i {}; i < packed.size(); ++i) {
+			sequence[i] = utility::decode(packed[i]);
+		}
+		for (int i {}; i < packed.size(); i+=80) {
+            os << sequence.substr(i, 100) << "\n";
         }
         ++count;
 
@@ -77,38 +177,275 @@ std::vector<std::string> Data::generate_motifs()
     for (const auto& size : m_motifLengths) {
         std::string tmp {};
         for (int i {}; i < size; ++i) {
-            tmp.push_back(utility::rand_nucleotide());
+            tmp.push_back(utility::rand_nucleotide(m_gen));
         }
         result.push_back(tmp);
     }
     return result;
 }
 
-Sequence Data::generate_sequence() 
+void Data::generate_sequence(int i, rng::Philox gen)
 {
-   	std::vector<Motif> motifs {};
+    std::uint64_t* words { m_packed.data() + m_packedOffsets[i] };
+    int num_words { (m_sequenceLength + 31) / 32 };
+
+    // uniform bases are uniform 2-bit codes, so every random word is 32 bases
+    for (int w {}; w < num_words; ++w) {
+        std::uint64_t hi { gen() };
+        words[w] = (hi << 32) | gen();
+    }
+    if (int tail { m_sequenceLength % 32 }) {
+        words[num_words - 1] &= (std::uint64_t { 1 } << (2 * tail)) - 1;
+    }
 
-    // create initial valuesi
-	std::string sequence {};
-	sequence.reserve(m_sequenceLength);
-    for (int i {}; i < m_sequenceLength; ++i) {
-        sequence.push_back(utility::rand_nucleotide());
+    if (m_motifs.empty()) {
+        return;
     }
 
-    // insert motifs
     int end_buffer { *std::max_element(begin(m_motifLengths), end(m_motifLengths)) };
-    auto indices { utility::rand_indices(m_sequenceLength, end_buffer, m_motifs.size()) }; 
-    for (int i {}; i < m_motifs.size(); ++i) {
-        sequence.replace(indices[i], m_motifLengths[i], m_motifs[i]);
-		motifs.push_back({
-			m_motifs[i],
-			m_motifs[i], // TODO: obfuscate w/ some SMALL probability
-			indices[i],
-			i
-		});
+    auto indices { utility::rand_indices(gen, m_sequenceLength, end_buffer, m_motifs.size()) }; 
+
+    auto& motifs { m_sequences[i].m_motifs };
+    motifs.reserve(m_motifs.size());
+    for (int m {}; m < static_cast<int>(m_motifs.size()); ++m) {
+        std::string motif { m_motifs[m] };
+        for (int j {}; j < static_cast<int>(motif.size()); ++j) {
+            int code { utility::encode(motif[j]) };
+            if (m_mutationRate > 0 && gen.canonical() < m_mutationRate) {
+                code = (code + 1 + gen.below(3)) & 3;
+                motif[j] = utility::decode(code);
+            }
+
+            int position { indices[m] + j };
+            int shift { 2 * (position & 31) };
+            std::uint64_t& word { words[position >> 5] };
+            word = (word & ~(std::uint64_t { 3 } << shift)) | (static_cast<std::uint64_t>(code) << shift);
+        }
+        motifs.push_back({
+            .m_motif = std::move(motif),
+            .m_baseMotif = m_motifs[m],
+            .m_startingIndex = indices[m],
+            .m_motifId = m
+        });
     }
+}
 
-	Sequence result { sequence, motifs };
-    return result; 
+Data::Loaded Data::load(const std::string& path, unsigned num_threads)
+{
+    auto file { std::make_unique<MappedFile>(path) };
+    if (file->size() >= sizeof(cache_format::FileHeader) && 
+        std::memcmp(file->data(), cache_format::magic, sizeof(cache_format::magic)) == 0) {
+        return load_cache(std::move(file), path);
+    }
+    file.reset();
+    return load_fasta(path, num_threads);
 }
 
+Data::Loaded Data::load_cache(std::unique_ptr<MappedFile> file, const std::string& path)
+{
+    using namespace cache_format;
+    const char* base { file->data() };
+    FileHeader header {};
+    std::memcpy(&header, base, sizeof(header));
+    if (header.version != version) {
+        throw std::runtime_error { path + " is a dataset cache of another version" };
+    }
+
+    std::size_t n { header.num_sequences };
+    // counts and sizes come from the file, so the bounds are checked by
+    // division rather than by products that could overflow
+    auto check = [&file, &path](std::uint64_t offset, std::uint64_t count, std::size_t size) {
+        if (offset % 8 != 0 || offset > file->size() || count > (file->size() - offset) / size) {
+            throw std::runtime_error { "truncated dataset cache " + path };
+        }
+    };
+    check(header.words_offset, header.num_words, sizeof(std::uint64_t));
+    check(header.offsets_offset, n, sizeof(std::uint64_t));
+    check(header.lengths_offset, n, sizeof(std::int32_t));
+    check(header.record_offsets_offset, n, sizeof(std::uint64_t));
+    check(header.record_offsets_offset + sizeof(std::uint64_t) * n, 1, sizeof(std::uint64_t));
+    check(header.records_offset, header.num_records, sizeof(MotifRecord));
+    check(header.motifs_offset, 1, sizeof(std::uint64_t));
+
+    // mmap is page aligned and every section 8-byte aligned, so the 
+    // sections are used in place
+    static_assert(sizeof(std::size_t) == sizeof(std::uint64_t));
+    Loaded result {};
+    result.mapped_words = { reinterpret_cast<const std::uint64_t*>(base + header.words_offset), header.num_words };
+    result.mapped_offsets = { reinterpret_cast<const std::size_t*>(base + header.offsets_offset), n };
+    result.mapped_lengths = { reinterpret_cast<const int*>(base + header.lengths_offset), n };
+    const auto* record_offsets { reinterpret_cast<const std::uint64_t*>(base + header.record_offsets_offset) };
+    const auto* records { reinterpret_cast<const MotifRecord*>(base + header.records_offset) };
+
+    std::size_t offset { header.motifs_offset };
+    std::uint64_t num_motifs {};
+    std::memcpy(&num_motifs, base + offset, sizeof(num_motifs));
+    offset += sizeof(num_motifs);
+    for (std::uint64_t m {}; m < num_motifs; ++m) {
+        std::uint64_t length {};
+        check(offset, 1, sizeof(length));
+        std::memcpy(&length, base + offset, sizeof(length));
+        offset += sizeof(length);
+        check(offset, length, 1);
+        check(offset, aligned(length), 1);
+        result.motifs.emplace_back(base + offset, length);
+        offset += aligned(length);
+    }
+
+    // every sequence must lie within the words, or PackedSequence and the
+    // samplers would read past the mapping
+    for (std::size_t i {}; i < n; ++i) {
+        std::uint64_t offset { result.mapped_offsets[i] };
+        int length { result.mapped_lengths[i] };
+        if (length < 0 || offset > header.num_words ||
+            (static_cast<std::uint64_t>(length) + 31) / 32 > header.num_words - offset) {
+            throw std::runtime_error { "corrupt dataset cache " + path };
+        }
+    }
+
+    // the ground truth is small next to the sequences; each motif's bases
+    // are read back from the sequence it is embedded in
+    result.sequences.resize(n);
+    for (std::size_t i {}; i < n; ++i) {
+        PackedSequence seq { result.mapped_words.data() + result.mapped_offsets[i], result.mapped_lengths[i] };
+        if (record_offsets[i] > record_offsets[i + 1] || record_offsets[i + 1] > header.num_records) {
+            throw std::runtime_error { "corrupt dataset cache " + path };
+        }
+        for (auto r { record_offsets[i] }; r < record_offsets[i + 1]; ++r) {
+            const auto& record { records[r] };
+            if (record.id < 0 || record.id >= static_cast<int>(result.motifs.size()) || record.start < 0 ||
+                record.start + result.motifs[record.id].size() > static_cast<std::size_t>(seq.size())) {
+                throw std::runtime_error { "corrupt dataset cache " + path };
+            }
+            const auto& base_motif { result.motifs[record.id] };
+            std::string motif(base_motif.size(), ' ');
+            for (std::size_t j {}; j < motif.size(); ++j) {
+                motif[j] = utility::decode(seq[record.start + j]);
+            }
+            result.sequences[i].m_motifs.push_back({ 
+                .m_motif = std::move(motif),
+                .m_baseMotif = base_motif,
+                .m_startingIndex = record.start,
+                .m_motifId = record.id
+            });
+        }
+    }
+
+    result.mapping = std::move(file);
+    return result;
+}
+
+void Data::save(const std::string& path) const
+{
+    using namespace cache_format;
+    std::ofstream out { path, std::ios::binary | std::ios::trunc };
+    if (!out) {
+        throw std::runtime_error { "cannot write " + path };
+    }
+
+    std::size_t n { m_offsetsView.size() };
+    std::vector<std::uint64_t> record_offsets { 0 };
+    std::vector<MotifRecord> records {};
+    for (const auto& seq : m_sequences) {
+        for (const auto& motif : seq.m_motifs) {
+            records.push_back({ motif.m_startingIndex, motif.m_motifId });
+        }
+        record_offsets.push_back(records.size());
+    }
+
+    FileHeader header {};
+    std::memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = version;
+    header.num_sequences = n;
+    header.num_words = m_wordsView.size();
+    header.num_records = records.size();
+    header.words_offset = sizeof(header);
+    header.offsets_offset = header.words_offset + sizeof(std::uint64_t) * header.num_words;
+    header.lengths_offset = header.offsets_offset + sizeof(std::uint64_t) * n;
+    header.record_offsets_offset = header.lengths_offset + aligned(sizeof(std::int32_t) * n);
+    header.records_offset = header.record_offsets_offset + sizeof(std::uint64_t) * (n + 1);
+    header.motifs_offset = header.records_offset + sizeof(MotifRecord) * records.size();
+
+    static_assert(sizeof(header) % 8 == 0 && sizeof(MotifRecord) == 8);
+    auto write = [&out](const void* data, std::size_t bytes) {
+        out.write(static_cast<const char*>(data), bytes);
+    };
+    const char padding[8] {};
+    write(&header, sizeof(header));
+    write(m_wordsView.data(), m_wordsView.size_bytes());
+    write(m_offsetsView.data(), m_offsetsView.size_bytes());
+    write(m_lengthsView.data(), m_lengthsView.size_bytes());
+    write(padding, aligned(m_lengthsView.size_bytes()) - m_lengthsView.size_bytes());
+    write(record_offsets.data(), sizeof(std::uint64_t) * record_offsets.size());
+    write(records.data(), sizeof(MotifRecord) * records.size());
+
+    std::uint64_t num_motifs { m_motifs.size() };
+    write(&num_motifs, sizeof(num_motifs));
+    for (const auto& motif : m_motifs) {
+        std::uint64_t length { motif.size() };
+        write(&length, sizeof(length));
+        write(motif.data(), length);
+        write(padding, aligned(length) - length);
+    }
+
+    if (!out) {
+        throw std::runtime_error { "cannot write " + path };
+    }
+}
+
+Data::Loaded Data::load_fasta(const std::string& path, unsigned num_threads)
+{
+    MappedFile file { path };
+    const char* file_begin { file.data() };
+    const char* file_end { file_begin + file.size() };
+
+    ThreadPool pool { num_threads };
+
+    // chunk boundaries sit on record starts so no record is split
+    std::size_t num_chunks { file.size() > (1 << 20) ? pool.size() : 1 };
+    std::vector<const char*> bounds { file_begin };
+    for (std::size_t c { 1 }; c < num_chunks; ++c) {
+        const char* guess { file_begin + file.size() * c / num_chunks };
+        bounds.push_back(fasta::next_record(file_begin, std::max(guess, bounds.back()), file_end));
+    }
+    bounds.push_back(file_end);
+
+    std::vector<std::future<std::vector<fasta::Record>>> scans {};
+    for (std::size_t c {}; c < num_chunks; ++c) {
+        scans.push_back(pool.submit([=]() {
+            return fasta::scan_records(file_begin, bounds[c], bounds[c + 1]);
+        }));
+    }
+    std::vector<std::vector<fasta::Record>> chunks {};
+    for (auto& scan : scans) {
+        chunks.push_back(scan.get());
+    }
+
+    Loaded result {};
+    std::size_t num_words {};
+    for (const auto& chunk : chunks) {
+        for (const auto& record : chunk) {
+            result.sequences.push_back({ .m_sequence = {}, .m_motifs = {}, .m_name = record.name });
+            result.lengths.push_back(record.length);
+            result.offsets.push_back(num_words);
+            num_words += (static_cast<std::size_t>(record.length) + 31) / 32;
+        }
+    }
+    result.packed.assign(num_words, 0);
+
+    std::vector<std::future<void>> packs {};
+    std::size_t first {};
+    for (const auto& chunk : chunks) {
+        packs.push_back(pool.submit([&result, &chunk, first]() {
+            for (std::size_t i {}; i < chunk.size(); ++i) {
+                fasta::pack_record(chunk[i], result.packed.data() + result.offsets[first + i]);
+            }
+        }));
+        first += chunk.size();
+    }
+    for (auto& pack : packs) {
+        pack.get();
+    }
+
+    return result;
+}
@@ -1,16 +1,25 @@
 #pragma once
 
 #include "algorithm"
+#include "cstdint"
 #include "iostream"
-#include "random"
+#include "map"
+#include "memory"
+#include "mutex"
 #include "set"
+#include "span"
 #include "string"
+#include "string_view"
 #include "unordered_map"
 #include "utility"
 #include "vector"
 
+#include "background.hpp"
+#include "rng.hpp"
 #include "utility.hpp"
 
+class MappedFile;
+
 struct Motif
 {
     /* Possibly obfuscated motif due to simulated read errors */
@@ -28,11 +37,53 @@ struct Motif
 
 struct Sequence
 {
-    /* Full ACTG representation */
+    /* Full ACTG representation; empty for generated sequences and those
+     * loaded from a file, which are only kept packed (see Data::packed) 
+     */
 	std::string m_sequence;
 
     /* Motifs within the sequence */
 	std::vector<Motif> m_motifs;
+
+    /* FASTA header, without the leading '>' */
+	std::string m_name {};
+};
+
+/* Read-only view of a 2-bit packed sequence (32 nucleotides per word) */
+class PackedSequence
+{
+    public:
+        PackedSequence(const std::uint64_t* words, int length)
+            : m_words { words }, m_length { length } {}
+
+        /* Returns the encoding of the nucleotide at i, in {0, 1, 2, 3} */
+        int operator[](int i) const
+        {
+            return (m_words[i >> 5] >> (2 * (i & 31))) & 3;
+        }
+
+        int size() const { return m_length; }
+
+        /* Returns the (size() + 31) / 32 words holding the sequence */
+        const std::uint64_t* words() const { return m_words; }
+
+        /* Writes the encodings of [0, size()) to out */
+        void unpack(std::uint8_t* out) const
+        {
+            unpack(out, 0, m_length);
+        }
+
+        /* Writes the encodings of [begin, end) to out + begin */
+        void unpack(std::uint8_t* out, int begin, int end) const
+        {
+            for (int i { begin }; i < end; ++i) {
+                out[i] = (*this)[i];
+            }
+        }
+
+    private:
+        const std::uint64_t* m_words;
+        int m_length;
 };
 
 class Data
@@ -40,36 +91,149 @@ class Data
     public: 
         /* Initializes a sequence dataset with embedded motifs
          * motif_lengths : vector containing the length of motifs to embed
+         * gen : generator for every random draw; defaults to the data stream
+         * of the process-wide seed so datasets are reproducible
+         * mutation_rate : probability that each base of an embedded motif 
+         * is replaced by one of the other three, simulating read errors
+         * num_threads : 0 uses one thread per hardware thread; small 
+         * datasets are generated on the calling thread
+         * Sequence i draws from its own sub-stream of gen, so the dataset 
+         * does not depend on num_threads. Throws std::invalid_argument if 
+         * the motifs cannot fit side by side in a sequence.
          */
         Data(
             const std::vector<int>& motif_lengths, 
             int num_sequences = 10,
-            int sequence_length = 1'000
+            int sequence_length = 1'000,
+            rng::Philox gen = rng::stream(rng::data_stream),
+            double mutation_rate = 0,
+            unsigned num_threads = 0
         );
 
+        /* Loads a dataset cache written by save(), whose packed storage is
+         * mmapped and used in place, or else every record of a FASTA file, 
+         * which is mmapped and parsed in parallel chunks straight into 
+         * packed storage
+         * num_threads : 0 uses one thread per hardware thread
+         * Chars outside {A, C, T, G} (e.g. N) are stored as A.
+         * Throws std::runtime_error if the file cannot be read.
+         */
+        explicit Data(const std::string& path, unsigned num_threads = 0);
+        ~Data();
+
+        /* Datasets may be many GB; share them by reference or DataHandle */
+        Data(const Data&) = delete;
+        Data& operator=(const Data&) = delete;
+
+        /* Writes the packed sequences and ground truth to path as a dataset
+         * cache (see data_cache.hpp); FASTA names are not kept.
+         * Throws std::runtime_error if path cannot be written.
+         */
+        void save(const std::string& path) const;
+
         /* Returns all created Sequences */
         const std::vector<Sequence>& sequences() const;
 
-        /* Returns (num_sequences, sequence_length) */
+        /* Returns the pre-encoded, 2-bit packed copy of sequence i */
+        PackedSequence packed(int i) const;
+
+        /* Views into the dataset, valid as long as it is */
+        std::span<const Motif> motifs(int i) const { return m_sequences[i].m_motifs; }
+        std::string_view name(int i) const { return m_sequences[i].m_name; }
+
+        /* Packed storage of every sequence; sequence i starts at word 
+         * offsets()[i] and is lengths()[i] nucleotides long 
+         */
+        std::span<const std::uint64_t> words() const { return m_wordsView; }
+        std::span<const std::size_t> offsets() const { return m_offsetsView; }
+        std::span<const int> lengths() const { return m_lengthsView; }
+
+        /* Returns the background model of the given order over every 
+         * sequence, counted on first use and cached for the dataset's 
+         * lifetime; safe to call from several threads
+         * Throws std::invalid_argument for orders outside 
+         * [0, Background::max_order].
+         */
+        const Background& background(int order = 0) const;
+
+        /* Returns (num_sequences, sequence_length); for loaded data the 
+         * length is that of the longest sequence 
+         */
         const std::pair<int, int> size() const;
         
         /* Allows for pretty printing Data */
         friend std::ostream& operator<<(std::ostream& os, const Data& obj);
 
     private:
+        /* Packed records produced by a file loader */
+        struct Loaded
+        {
+            std::vector<Sequence> sequences;
+            std::vector<int> lengths;
+            std::vector<std::uint64_t> packed;
+            std::vector<std::size_t> offsets;
+            std::vector<std::string> motifs {};
+
+            /* Set when the packed storage is the mapped file's instead of 
+             * the vectors above 
+             */
+            std::unique_ptr<MappedFile> mapping {};
+            std::span<const std::uint64_t> mapped_words {};
+            std::span<const std::size_t> mapped_offsets {};
+            std::span<const int> mapped_lengths {};
+        };
+
+        explicit Data(Loaded&& loaded);
+
         const int m_numSequences; 
         const int m_sequenceLength;
         const std::vector<int> m_motifLengths;
+        const double m_mutationRate;
+
+        rng::Philox m_gen;
 
 		/* simulated consensus motifs before random obfuscation */
         const std::vector<std::string> m_motifs;
 
         std::vector<Sequence> m_sequences;    
 
+        /* 2-bit packed copies of m_sequences; sequence i starts at word 
+         * m_packedOffsets[i] 
+         */
+        std::vector<std::uint64_t> m_packed;
+        std::vector<std::size_t> m_packedOffsets;
+        std::vector<int> m_lengths;
+
+        /* Backs the packed storage of a mapped cache, in place of the 
+         * vectors above
+         */
+        std::unique_ptr<MappedFile> m_mapping;
+
+        /* The packed storage in use, owned or mapped */
+        std::span<const std::uint64_t> m_wordsView;
+        std::span<const std::size_t> m_offsetsView;
+        std::span<const int> m_lengthsView;
+
+        /* Background models counted so far, by order */
+        mutable std::mutex m_backgroundMutex;
+        mutable std::map<int, std::unique_ptr<const Background>> m_backgrounds;
+
         /* Returns N motifs with lengths corresponding to motif_lengths */
         std::vector<std::string> generate_motifs(); 
 
-        /* Generates a Sequence with a set of motifs with lengths specified in m_motifLengths */
-        Sequence generate_sequence();
+        /* Fills sequence i straight into packed storage from whole words of
+         * random bits and embeds one (possibly mutated) copy of every motif
+         */
+        void generate_sequence(int i, rng::Philox gen);
+
+        static Loaded load(const std::string& path, unsigned num_threads);
+        static Loaded load_fasta(const std::string& path, unsigned num_threads);
+        static Loaded load_cache(std::unique_ptr<MappedFile> file, 
+            const std::string& path);
 };
 
+/* Reference-counted handle to an immutable dataset. Samplers constructed 
+ * from one keep the dataset alive and share it, with no copies, with their
+ * chains and threads.
+ */
+using DataHandle = std::shared_ptr<const Data>;
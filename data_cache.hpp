@@ -0,0 +1,52 @@
+#pragma once
+
+#include "cstddef"
+#include "cstdint"
+
+/* On-disk layout of a dataset cache: a whole Data in the form it is held
+ * in memory, so it can be mmapped and used in place. Every section starts
+ * 8-byte aligned.
+ *
+ * FileHeader | words | offsets | lengths | record offsets | records | motif table
+ * words : u64[num_words], the 2-bit packed sequences
+ * offsets : u64[num_sequences], first word of each sequence
+ * lengths : i32[num_sequences], padded to 8 bytes
+ * record offsets : u64[num_sequences + 1]; sequence i owns records
+ * [record_offsets[i], record_offsets[i+1])
+ * records : MotifRecord[num_records], the embedded motifs
+ * motif table : u64 count | (u64 length | chars padded to 8 bytes) per motif
+ */
+namespace cache_format {
+    inline constexpr char magic[8] { 'M', 'O', 'T', 'I', 'F', 'D', 'A', 'T' };
+    inline constexpr std::uint32_t version { 1 };
+
+    struct FileHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t reserved;
+        std::uint64_t num_sequences;
+        std::uint64_t num_words;
+        std::uint64_t num_records;
+        std::uint64_t words_offset;
+        std::uint64_t offsets_offset;
+        std::uint64_t lengths_offset;
+        std::uint64_t record_offsets_offset;
+        std::uint64_t records_offset;
+        std::uint64_t motifs_offset;
+    };
+
+    /* Ground truth of one embedded motif; its possibly mutated bases are
+     * those of the sequence at start
+     */
+    struct MotifRecord
+    {
+        std::int32_t start;
+        std::int32_t id;
+    };
+
+    inline constexpr std::size_t aligned(std::size_t bytes)
+    {
+        return (bytes + 7) / 8 * 8;
+    }
+}
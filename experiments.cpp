@@ -0,0 +1,136 @@
+#include "algorithm"
+#include "fstream"
+#include "iostream"
+#include "sstream"
+#include "string"
+#include "vector"
+
+#include "convergence.hpp"
+#include "rng.hpp"
+#include "sweep.hpp"
+
+/* Parameter sweep driver: runs every cell of a grid several times, side
+ * by side on all cores, and writes one CSV row per run. Without a grid it
+ * runs default_sweep(). Runs share the machine, so wall times are
+ * comparable within a sweep rather than with runs on an idle one.
+ */
+namespace {
+    struct Options
+    {
+        std::vector<int> num_motifs {};
+        std::vector<int> motif_lengths {};
+        std::vector<int> num_sequences {};
+        std::vector<int> sequence_lengths {};
+        int reps { 10 };
+        unsigned num_threads {};
+        unsigned hogwild_threads { 1 };
+        int max_iters { 10'000 };
+        std::string csv_path {};
+    };
+
+    /* Parses a comma-separated list of positive ints */
+    bool parse_list(const std::string& arg, std::vector<int>& values)
+    {
+        std::istringstream items { arg };
+        for (std::string item {}; std::getline(items, item, ','); ) {
+            int value { std::stoi(item) };
+            if (value < 1) {
+                return false;
+            }
+            values.push_back(value);
+        }
+        return !values.empty();
+    }
+
+    bool parse(int argc, char* argv[], Options& options)
+    {
+        for (int i { 1 }; i < argc; ++i) {
+            std::string arg { argv[i] };
+            bool has_value { i + 1 < argc };
+            if (arg == "--seed" && has_value) {
+                rng::set_seed(std::stoull(argv[++i]));
+            } else if (arg == "--motifs" && has_value) {
+                if (!parse_list(argv[++i], options.num_motifs)) {
+                    return false;
+                }
+            } else if (arg == "--motif-lengths" && has_value) {
+                if (!parse_list(argv[++i], options.motif_lengths)) {
+                    return false;
+                }
+            } else if (arg == "--sequences" && has_value) {
+                if (!parse_list(argv[++i], options.num_sequences)) {
+                    return false;
+                }
+            } else if (arg == "--sequence-lengths" && has_value) {
+                if (!parse_list(argv[++i], options.sequence_lengths)) {
+                    return false;
+                }
+            } else if (arg == "--reps" && has_value) {
+                options.reps = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--threads" && has_value) {
+                options.num_threads = std::stoul(argv[++i]);
+            } else if (arg == "--hogwild" && has_value) {
+                options.hogwild_threads = std::max(1ul, std::stoul(argv[++i]));
+            } else if (arg == "--max-iters" && has_value) {
+                options.max_iters = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--csv" && has_value) {
+                options.csv_path = argv[++i];
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options {};
+    if (!parse(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--motifs <n,...>] [--motif-lengths <n,...>] "
+                  << "[--sequences <n,...>] [--sequence-lengths <n,...>] [--reps <n>] "
+                  << "[--threads <n>] [--hogwild <n>] [--max-iters <n>] [--seed <seed>] "
+                  << "[--csv <path>]\n"
+                  << "Runs every combination of the lists given (defaults 2, 16, 16, 480), or "
+                  << "each parameter in turn around those if none is\n"
+                  << "--hogwild runs every chain on n threads at once, to compare with a "
+                  << "sweep of the same seed without it\n"
+                  << "Writes CSV to stdout unless --csv is given\n";
+        return 1;
+    }
+
+    bool has_grid { !options.num_motifs.empty() || !options.motif_lengths.empty() ||
+        !options.num_sequences.empty() || !options.sequence_lengths.empty() };
+    auto or_default = [](const std::vector<int>& values, int value) {
+        return values.empty() ? std::vector<int> { value } : values;
+    };
+    std::vector<SweepCell> cells { has_grid ?
+        sweep_grid(or_default(options.num_motifs, 2), or_default(options.motif_lengths, 16),
+            or_default(options.num_sequences, 16), or_default(options.sequence_lengths, 480)) :
+        default_sweep() };
+
+    std::size_t total { cells.size() * options.reps };
+    std::size_t done {};
+    std::cerr << "seed: " << rng::seed() << "\n"
+              << "running " << cells.size() << " cells x " << options.reps << " reps\n";
+
+    std::vector<SweepRun> runs {};
+    try {
+        runs = run_sweep(cells, options.reps, StableConsensus { 200, options.max_iters },
+            rng::seed(), options.num_threads, [&done, total](const SweepRun&) {
+                std::cerr << "\r" << ++done << "/" << total << std::flush;
+            }, options.hogwild_threads);
+    } catch (const std::exception& e) {
+        std::cerr << "\n" << e.what() << "\n";
+        return 1;
+    }
+    std::cerr << "\n";
+
+    if (options.csv_path.empty()) {
+        write_sweep_csv(std::cout, runs);
+        return 0;
+    }
+    std::ofstream csv { options.csv_path };
+    write_sweep_csv(csv, runs);
+    return 0;
+}
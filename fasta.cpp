@@ -0,0 +1,72 @@
+#include "cstring"
+#include "string"
+#include "vector"
+
+#include "fasta.hpp"
+#include "utility.hpp"
+
+namespace {
+    bool is_base(char c)
+    {
+        return utility::encode(c) != utility::invalid_nucleotide;
+    }
+}
+
+const char* fasta::next_record(const char* file_begin, const char* pos, 
+    const char* end)
+{
+    while (pos < end) {
+        if (*pos == '>' && (pos == file_begin || pos[-1] == '\n')) {
+            return pos;
+        }
+        const void* newline { std::memchr(pos, '\n', end - pos) };
+        pos = newline ? static_cast<const char*>(newline) + 1 : end;
+    }
+    return end;
+}
+
+fasta::Record fasta::read_record(const char* file_begin, const char* pos, 
+    const char* end)
+{
+    const void* newline { std::memchr(pos, '\n', end - pos) };
+    const char* header_end { newline ? static_cast<const char*>(newline) : end };
+    const char* body_begin { newline ? header_end + 1 : end };
+    const char* body_end { next_record(file_begin, body_begin, end) };
+
+    std::string name { pos + 1, header_end };
+    if (!name.empty() && name.back() == '\r') {
+        name.pop_back();
+    }
+
+    int length {};
+    for (const char* c { body_begin }; c < body_end; ++c) {
+        length += is_base(*c);
+    }
+
+    return { std::move(name), body_begin, body_end, length };
+}
+
+std::vector<fasta::Record> fasta::scan_records(const char* file_begin, 
+    const char* begin, const char* end)
+{
+    std::vector<Record> result {};
+    const char* pos { next_record(file_begin, begin, end) };
+    while (pos < end) {
+        result.push_back(read_record(file_begin, pos, end));
+        pos = result.back().body_end;
+    }
+    return result;
+}
+
+void fasta::pack_record(const Record& record, std::uint64_t* words)
+{
+    std::size_t j {};
+    for (const char* c { record.body_begin }; c < record.body_end; ++c) {
+        if (!is_base(*c)) {
+            continue;
+        }
+        std::uint64_t code { static_cast<std::uint64_t>(utility::encode(*c)) };
+        words[j / 32] |= code << (2 * (j % 32));
+        ++j;
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "cstdint"
+#include "string"
+#include "vector"
+
+/* Zero-copy helpers for FASTA text held in memory (e.g. a MappedFile) */
+namespace fasta {
+    /* A FASTA record located inside a mapped file */
+    struct Record
+    {
+        std::string name;
+        const char* body_begin;
+        const char* body_end;
+
+        /* Number of A, C, T and G (either case) in [body_begin, body_end) */
+        int length;
+    };
+
+    /* Returns the first record start ('>' at the beginning of a line) in 
+     * [pos, end), or end 
+     */
+    const char* next_record(const char* file_begin, const char* pos, 
+        const char* end);
+
+    /* Parses the record starting at pos; its body ends at the next record 
+     * start or at end 
+     */
+    Record read_record(const char* file_begin, const char* pos, const char* end);
+
+    /* Locates and measures every record starting in [begin, end), which 
+     * must itself start at a record boundary 
+     */
+    std::vector<Record> scan_records(const char* file_begin, const char* begin, 
+        const char* end);
+
+    /* Packs the body of record into zeroed words; chars outside 
+     * {A, C, T, G} (N and other ambiguity codes included) are skipped, so 
+     * they do not count towards the background 
+     */
+    void pack_record(const Record& record, std::uint64_t* words);
+}
@@ -1,133 +1,469 @@
 #pragma once
 
+#include "algorithm"
+#include "array"
 #include "cassert"
+#include "cmath"
+#include "limits"
+#include "numeric"
+#include "utility"
 #include "vector"
 
 #include "data.hpp"
+#include "instrumentation.hpp"
+#include "kernels.hpp"
+#include "mask.hpp"
+#include "pwm.hpp"
+#include "rng.hpp"
+#include "thread_pool.hpp"
 
 struct Result
 {
+	/* Leftmost index of the motif in each sequence */
 	std::vector<int> positions;
+
+	/* True where the motif was found on the reverse strand; all false 
+	 * unless the sampler scans both strands 
+	 */
+	std::vector<bool> reverse_strand;
+
 	int num_correct;
 	std::string consensus;
+
+	/* Id of the embedded motif most positions match; -1 without ground truth */
+	int motif_id { -1 };
+
+	/* Log-odds score of the motifs at positions under the final PWM */
+	double log_likelihood {};
+
+	int iterations {};
+
+	/* True if the chain stopped on its convergence criterion rather than
+	 * on the iteration limit or a stop request
+	 */
+	bool converged {};
+
+	/* With pruned scoring: the fraction of windows pruned and the largest 
+	 * bound on the total variation distance between a pruned distribution 
+	 * and the exact one 
+	 */
+	double pruned_fraction {};
+	double prune_error {};
+
+	/* Per-phase timings; all zero unless built with -DINSTRUMENT */
+	Stats stats {};
 };
 
 template <typename T>
 class GibbsSampler {
     public: 
-        GibbsSampler(const Data& data);
+        /* gen : generator for every random draw of the sampler; defaults to
+         * the sampler stream of the process-wide seed
+         */
+        GibbsSampler(const Data& data, 
+			rng::Philox gen = rng::stream(rng::sampler_stream));
+
+		/* Shares ownership of data instead of borrowing it */
+        GibbsSampler(DataHandle data, 
+			rng::Philox gen = rng::stream(rng::sampler_stream));
 		virtual ~GibbsSampler() = default;
 
         [[nodiscard]] virtual Result find_motifs(int k, T pseudocount) = 0;
 
+		/* Keeps every window off the regions claimed in mask (not owned); 
+		 * nullptr removes the mask 
+		 */
+		virtual void set_mask(const Mask* mask) { m_mask = mask; }
+
+		/* Splits score() over pool (not owned) for sequences with at least
+		 * min_windows windows; the calling thread takes one chunk itself.
+		 * nullptr scores every sequence on the calling thread.
+		 */
+		void set_score_pool(ThreadPool* pool, int min_windows = 1 << 16);
+
+		/* Abandons windows whose best possible score falls more than cutoff
+		 * (in nats) below the best window seen so far, giving them zero 
+		 * probability; each costs at most exp(-cutoff) relative mass. 
+		 * 0 scores every window in full.
+		 */
+		void set_pruning(T cutoff) { m_pruneCutoff = cutoff; }
+
+		/* Also scores every window's reverse complement, in the same pass 
+		 * over the sequence, so motifs may be sampled on either strand 
+		 */
+		void set_both_strands(bool both) { m_bothStrands = both; }
+
+		/* Scores windows against an order-m Markov background of the data
+		 * (see Data::background), so each base is weighed against its 
+		 * probability given the m bases before it; the first m bases of a
+		 * sequence fall back to base frequencies. 0 uses base frequencies 
+		 * alone. Pruning is skipped for m > 0, since the background no 
+		 * longer folds into the PWM's best-case bounds.
+		 * Throws std::invalid_argument for m outside [0, Background::max_order].
+		 */
+		virtual void set_background_order(int order);
+
     protected:
-        const Data m_data;
+		/* For samplers whose sequences do not (all) live in data; uses the 
+		 * given background distribution instead of estimating it from data 
+		 */
+        GibbsSampler(const Data& data, const std::array<T, 4>& background, 
+			rng::Philox gen);
+
+        /* Not owned unless the sampler holds m_dataHandle; must outlive 
+		 * the sampler otherwise. Shared read-only between samplers and 
+		 * threads 
+		 */
+        const Data& m_data;
+		DataHandle m_dataHandle;
+
+		rng::Philox m_gen;
+
+		/* Positions taken and returned by the helpers below are sites, the
+		 * indices score() and sample() work in: for a sequence with 
+		 * n = length - k windows, site s < n is the forward window at s and,
+		 * when scanning both strands, site n + s is its reverse complement.
+		 * On one strand a site is simply the starting position.
+		 */
 
 		/* Returns the number of correctly estimated motif starting positions 
 		 * Note: overlap is considered "correct"
 		 */
 		int num_correct(std::vector<int>& positions, int k);
+
+		/* Returns (motif id, count) for the embedded motif matched by the 
+		 * most positions, or (-1, 0) without ground truth 
+		 */
+		std::pair<int, int> best_match(const std::vector<int>& positions, int k);
+
+		const Mask* mask() const { return m_mask; }
+
+		ThreadPool* score_pool() const { return m_scorePool; }
+		int min_parallel_windows() const { return m_minParallelWindows; }
+		T prune_cutoff() const { return m_pruneCutoff; }
+		bool both_strands() const { return m_bothStrands; }
+		int background_order() const { return m_contextOrder; }
+
+		/* Returns a random site of an unmasked window of width in sequence 
+		 * seq_index 
+		 */
+		int random_position(int seq_index, int width);
+
+		/* Returns a random site for a k-mer in a sequence of length */
+		int random_site(int length, int k);
+
+		/* Returns (starting position, on the reverse strand) of site */
+		std::pair<int, bool> decode_site(int length, int k, int site) const;
+
+		/* Fills result.positions and result.reverse_strand from sites */
+		void set_positions(Result& result, const std::vector<int>& sites, int k) const;
+
+		/* Returns the summed log-odds of the k-mer at site of seq, less its
+		 * background log-probability when it is of order > 0
+		 */
+		T site_score(const std::vector<T>& log_odds, const PackedSequence& seq, 
+			int k, int site) const;
 		
-		/* Calculates the consensus motif based on a current PWM */
-		std::string consensus(std::vector<T>& pwm, int k);
-        
+		/* Returns the summed log-odds of the k-mers at positions under pwm */
+		T log_likelihood(Pwm<T>& pwm, const std::vector<int>& positions);
+
 		/* Initializes random motif starting positions for each sequence 
 		 * in m_data 
 		 */
 		std::vector<int> init_positions(int end_buffer);
 
+		/* Returns an empty PWM over this sampler's background */
+		Pwm<T> make_pwm(int k, T pseudocount) const;
+
 		/* Initializes a PWM from ALL sequences. 
 		 * positions : motif starting positions for each sequence
 		 */
-		std::vector<T> init_pwm(std::vector<int>& positions, int k, 
-			T pseudocount);
+		Pwm<T> init_pwm(std::vector<int>& positions, int k, T pseudocount);
 
-		std::vector<T> update_pwm(std::vector<T>& pwm, 
-			std::vector<int>& positions, int k, T pseudocount, int old_withheld,
-			int new_withheld);
+		/* Adds old_withheld back into pwm and removes new_withheld */
+		void update_pwm(Pwm<T>& pwm, std::vector<int>& positions, 
+			int old_withheld, int new_withheld);
 
 		/* Helper function to update the PWM
 		 * seq_index : sequence to use to update the PWM
 		 * start_pos : current idx where the motif is estimated to start
 		 * increment : true if adding to the PWM, false if removing
 		 */
-		void update_counts(std::vector<T>& pwm, int seq_index, int start_pos, 
-			int k, T pseudocount, bool increment = true);
+		void update_counts(Pwm<T>& pwm, int seq_index, int start_pos, 
+			bool increment = true);
+
+		/* Adds (increment) or removes the k-mer at site of seq */
+		void update_site(Pwm<T>& pwm, const PackedSequence& seq, int site, 
+			bool increment = true) const;
 
-		/* Scores each k-mer in the withheld sequence using the PWM 
-		 * Returns a probability distribution
+		/* Scores each k-mer in the withheld sequence using the log-odds 
+		 * of pwm
+		 * Returns a probability distribution over sites, valid until the 
+		 * next call
 		 */
-		std::vector<T> score(std::vector<T>& pwm, int k, int withheld);
+		const std::vector<T>& score(Pwm<T>& pwm, int withheld);
+		const std::vector<T>& score(Pwm<T>& pwm, const PackedSequence& seq);
+
+		/* Unnormalized log-odds of every site of seq, in m_scores */
+		std::vector<T>& score_windows(Pwm<T>& pwm, const PackedSequence& seq);
 
-		/* Samples index space covered by the prob distribution in scores */
-		int sample(std::vector<T> scores);
+		/* Turns log scores into a probability distribution in place */
+		const std::vector<T>& normalize(std::vector<T>& score);
+
+		/* Windows scored and pruned since reset_prune_report(), and the 
+		 * largest total variation bound of a single score() call 
+		 */
+		struct PruneReport
+		{
+			long windows;
+			long pruned;
+			double max_error;
+		};
+
+		const PruneReport& prune_report() const { return m_pruneReport; }
+		void reset_prune_report() { m_pruneReport = {}; }
+
+		/* Samples index space covered by the prob distribution in scores 
+		 * by inverse-CDF lookup; does not allocate once buffers are sized
+		 */
+		int sample(const std::vector<T>& scores);
 
 	private:
+		const Mask* m_mask {};
+
+		ThreadPool* m_scorePool {};
+		int m_minParallelWindows {};
+		std::vector<std::future<void>> m_chunks;
+
+		/* Per-chunk max and sum of exp(score - max) for normalize() */
+		std::vector<T> m_chunkMax;
+		std::vector<T> m_chunkSum;
+
         const std::array<T, 4> m_background;
+        const std::array<T, 4> m_logBackground;
 
-		/* Calculates the sum of 2 log probabilities */
-		T sum_log_probs(T a, T b);
+		T m_pruneCutoff {};
+		PruneReport m_pruneReport {};
+		bool m_bothStrands {};
 
-		/* Calculates the background taxon distribution in m_data */
-		std::array<T, 4> calculate_noise(int sample_size = 100);
+		/* Order of the background model, and log P(base | context) 
+		 * indexed by Background::context() << 2 | base 
+		 */
+		int m_contextOrder {};
+		std::vector<T> m_contextLogs;
+
+		/* Background log-probability of each base of the sequence being 
+		 * scored, for orders > 0 
+		 */
+		std::vector<T> m_baseLogs;
+
+		/* Best suffix scores for pruning (forward, then reverse complement) 
+		 * and windows pruned per chunk 
+		 */
+		std::vector<T> m_suffixMax;
+		std::vector<int> m_chunkPruned;
+
+		/* Reverse complement log-odds laid out like the PWM, for pruning */
+		std::vector<T> m_rcLogOdds;
+
+		/* Window kernels specialized for motif length m_kernelK */
+		kernels::ScoreFn<T> m_kernel {};
+		kernels::BothStrandsFn<T> m_bothKernel {};
+		int m_kernelK {};
+
+		/* Unpacked encodings of the sequence being scored */
+		std::vector<std::uint8_t> m_bases;
+
+		/* Reused buffers for score() output and sample()'s prefix sums */
+		std::vector<T> m_scores;
+		std::vector<T> m_cdf;
+
+		static std::array<T, 4> log_background(const std::array<T, 4>& background);
+
+		/* Number of chunks for_chunks splits n items into */
+		int num_chunks(int n) const;
+
+		/* Calls func(chunk, begin, end) over num_chunks(n) contiguous ranges 
+		 * of [0, n), in parallel on the score pool when n is large enough 
+		 */
+		template <typename F>
+		void for_chunks(int n, F&& func);
+
+		/* Returns the exact base distribution of m_data */
+		std::array<T, 4> calculate_noise() const;
+
+		bool pruning() const { return m_pruneCutoff > 0 && !m_contextOrder; }
+
+		/* Background log-probability of bases [begin, end) of seq under 
+		 * the order-m model
+		 */
+		T context_score(const PackedSequence& seq, int begin, int end) const;
+
+		/* Subtracts each window's background log-probability from both 
+		 * strands of score, with m_bases holding the sequence 
+		 */
+		void subtract_background(std::vector<T>& score, int length, int k);
 };
 
 template <typename T>
-GibbsSampler<T>::GibbsSampler(const Data& data) 
+GibbsSampler<T>::GibbsSampler(const Data& data, rng::Philox gen) 
+	: m_data { data },
+	  m_gen { gen },
+	  m_background { calculate_noise() },
+	  m_logBackground { log_background(m_background) }
+{
+}
+
+template <typename T>
+GibbsSampler<T>::GibbsSampler(DataHandle data, rng::Philox gen) 
+	: GibbsSampler(*data, gen)
+{
+	m_dataHandle = std::move(data);
+}
+
+template <typename T>
+GibbsSampler<T>::GibbsSampler(const Data& data, 
+	const std::array<T, 4>& background, rng::Philox gen) 
 	: m_data { data },
-	  m_background { calculate_noise() }
+	  m_gen { gen },
+	  m_background { background },
+	  m_logBackground { log_background(m_background) }
+{
+}
+
+template <typename T>
+std::array<T, 4> GibbsSampler<T>::log_background(const std::array<T, 4>& background)
+{
+	return {
+		std::log(background[0]), std::log(background[1]),
+		std::log(background[2]), std::log(background[3])
+	};
+}
+
+template <typename T>
+void GibbsSampler<T>::set_score_pool(ThreadPool* pool, int min_windows)
+{
+	m_scorePool = pool;
+	m_minParallelWindows = min_windows;
+}
+
+template <typename T>
+int GibbsSampler<T>::num_chunks(int n) const
+{
+	return m_scorePool && n >= m_minParallelWindows ? m_scorePool->size() + 1 : 1;
+}
+
+template <typename T>
+template <typename F>
+void GibbsSampler<T>::for_chunks(int n, F&& func)
+{
+	int chunks { num_chunks(n) };
+	auto bound = [n, chunks](int c) { 
+		return static_cast<int>(static_cast<long>(n) * c / chunks); 
+	};
+
+	m_chunks.clear();
+	for (int c { 1 }; c < chunks; ++c) {
+		m_chunks.push_back(m_scorePool->submit([&func, &bound, c]() { 
+			func(c, bound(c), bound(c + 1)); 
+		}));
+	}
+	func(0, 0, bound(1));
+	for (auto& chunk : m_chunks) {
+		chunk.get();
+	}
+}
+
+template <typename T>
+std::array<T, 4> GibbsSampler<T>::calculate_noise() const
 {
+    // counted once per dataset and shared by every sampler over it
+    auto freqs { m_data.background().frequencies() };
+    return { 
+        static_cast<T>(freqs[0]), static_cast<T>(freqs[1]), 
+        static_cast<T>(freqs[2]), static_cast<T>(freqs[3]) 
+    };
 }
 
 template <typename T>
-T GibbsSampler<T>::sum_log_probs(T a, T b)
+void GibbsSampler<T>::set_background_order(int order)
 {
-	return a > b ?
-		a + std::log1p(std::exp(b-a)) :
-		b + std::log1p(std::exp(a-b));
+	m_contextOrder = 0;
+	m_contextLogs.clear();
+	if (order == 0) {
+		return;
+	}
+
+	const auto& logs { m_data.background(order).log_conditional() };
+	m_contextLogs.assign(begin(logs), end(logs));
+	m_contextOrder = order;
 }
 
 template <typename T>
-std::array<T, 4> GibbsSampler<T>::calculate_noise(int sample_size)
+T GibbsSampler<T>::context_score(const PackedSequence& seq, int begin, int end) const
 {
-    // sample 100 positions with replacement
-    auto [num_sequences, sequence_length] { m_data.size() };
-    std::array<T, 4> result; 
-
-    char tmp;
-    int samples_per_seq { (sample_size + num_sequences - 1) / num_sequences };
-    const std::vector<Sequence> seqs { m_data.sequences() };
-    for (int i {}; i < num_sequences; ++i) {
-        for (int j {}; j < samples_per_seq; ++j) {
-            auto idx = utility::rand_indices(sequence_length)[0]; 
-            tmp = seqs[i].m_sequence[idx];    
-            ++result[utility::encode(tmp)];
-        }
+	std::uint32_t ctx {};
+	for (int i { std::max(0, begin - m_contextOrder) }; i < begin; ++i) {
+		ctx = Background::context(ctx, seq[i], m_contextOrder);
 	}
 
-    // normalize to get probability distribution
-    int total_samples { samples_per_seq * num_sequences };
-    std::transform(begin(result), end(result), begin(result), [&total_samples](T x) {
-        return x / total_samples;
-    });
+	T result {};
+	for (int i { begin }; i < end; ++i) {
+		int base { seq[i] };
+		result += i < m_contextOrder ? m_logBackground[base] : m_contextLogs[(ctx << 2) | base];
+		ctx = Background::context(ctx, base, m_contextOrder);
+	}
+	return result;
+}
 
-    return result;
+template <typename T>
+void GibbsSampler<T>::subtract_background(std::vector<T>& score, int length, int k)
+{
+	m_baseLogs.resize(length);
+	for_chunks(length, [this](int, int begin, int end) {
+		std::uint32_t ctx {};
+		for (int i { std::max(0, begin - m_contextOrder) }; i < begin; ++i) {
+			ctx = Background::context(ctx, m_bases[i], m_contextOrder);
+		}
+		for (int i { begin }; i < end; ++i) {
+			int base { m_bases[i] };
+			m_baseLogs[i] = i < m_contextOrder ? m_logBackground[base] : m_contextLogs[(ctx << 2) | base];
+			ctx = Background::context(ctx, base, m_contextOrder);
+		}
+	});
+
+	// a window's bases are the same on either strand, so both share its 
+	// sliding sum; kept in double so long sequences do not drift
+	int num_windows { length - k };
+	bool both { m_bothStrands };
+	for_chunks(num_windows, [this, &score, k, num_windows, both](int, int begin, int end) {
+		double window { std::accumulate(m_baseLogs.begin() + begin, 
+			m_baseLogs.begin() + begin + k, 0.0) };
+		for (int i { begin }; i < end; ++i) {
+			score[i] -= window;
+			if (both) {
+				score[num_windows + i] -= window;
+			}
+			window += m_baseLogs[i + k] - m_baseLogs[i];
+		}
+	});
 }
 
 template <typename T>
 int GibbsSampler<T>::num_correct(std::vector<int>& positions, int k)
 {
-	// what if have multiple motifs and looking for 1
-	// score based on all
-	// return max score
+	return best_match(positions, k).second;
+}
+
+template <typename T>
+std::pair<int, int> GibbsSampler<T>::best_match(const std::vector<int>& positions, int k)
+{
 	std::unordered_map<int, int> results {};
-	std::vector<Sequence> seqs { m_data.sequences() };
-	for (int i {}; i < positions.size(); ++i) {
-		for (int j {}; j < seqs[i].m_motifs.size(); ++j) {
-			auto& motif { seqs[i].m_motifs[j] };
-			if (std::abs(static_cast<int>(positions[i] - motif.m_startingIndex)) < k) {
+	for (int i {}; i < static_cast<int>(positions.size()); ++i) {
+		int position { decode_site(m_data.packed(i).size(), k, positions[i]).first };
+		for (const auto& motif : m_data.motifs(i)) {
+			if (std::abs(position - motif.m_startingIndex) < k) {
 				++results[motif.m_motifId];
-				break;
 			}
 		}
 	}
@@ -136,126 +472,304 @@ int GibbsSampler<T>::num_correct(std::vector<int>& positions, int k)
 		[](const std::pair<int, int>& a, const std::pair<int, int>& b) {
 			return a.second < b.second;
 		});
-	int result { results.empty() ? 0 : elm_it->second };
-	return result;
+	return results.empty() ? std::pair { -1, 0 } : std::pair<int, int> { *elm_it };
 }
 
 template <typename T>
-std::string GibbsSampler<T>::consensus(std::vector<T>& pwm, int k)
+T GibbsSampler<T>::log_likelihood(Pwm<T>& pwm, const std::vector<int>& positions)
 {
-	std::string result {};
-
-	for (int i {}; i < k; ++i) {
-		auto index {
-			std::distance(
-				begin(pwm)+4*i,
-				std::max_element(begin(pwm)+4*i, begin(pwm)+4*(i+1))
-			)
-		};
-		assert(index < 4); // decode requirement
-		result.push_back(utility::decode(index));
+	const auto& log_odds { pwm.log_odds() };
+	int k { pwm.k() };
+
+	T result {};
+	for (int i {}; i < static_cast<int>(positions.size()); ++i) {
+		result += site_score(log_odds, m_data.packed(i), k, positions[i]);
 	}
+	return result - positions.size() * k * pwm.log_normalizer();
+}
 
-	return result;
+template <typename T>
+T GibbsSampler<T>::site_score(const std::vector<T>& log_odds, 
+	const PackedSequence& seq, int k, int site) const
+{
+	auto [position, reverse] { decode_site(seq.size(), k, site) };
+	T result {};
+	for (int j {}; j < k; ++j) {
+		int base { reverse ? utility::complement(seq[position + k - 1 - j]) : seq[position + j] };
+		result += log_odds[4*j + base];
+	}
+	return m_contextOrder ? result - context_score(seq, position, position + k) : result;
+}
+
+template <typename T>
+std::pair<int, bool> GibbsSampler<T>::decode_site(int length, int k, int site) const
+{
+	int num_windows { length - k };
+	if (!m_bothStrands || site < num_windows) {
+		return { site, false };
+	}
+	return { site - num_windows, true };
+}
+
+template <typename T>
+void GibbsSampler<T>::set_positions(Result& result, const std::vector<int>& sites, 
+	int k) const
+{
+	result.positions.resize(sites.size());
+	result.reverse_strand.resize(sites.size());
+	for (int i {}; i < static_cast<int>(sites.size()); ++i) {
+		auto [position, reverse] { decode_site(m_data.packed(i).size(), k, sites[i]) };
+		result.positions[i] = position;
+		result.reverse_strand[i] = reverse;
+	}
 }
 
 template <typename T>
 std::vector<int> GibbsSampler<T>::init_positions(int width)
 {
-	auto [num_sequences, sequence_length] { m_data.size() };
+	int num_sequences { m_data.size().first };
 	std::vector<int> result(num_sequences);
 
-	std::generate(begin(result), end(result), [&]() {
-		return utility::rand_indices(sequence_length, width)[0]; 
-	});
+	for (int i {}; i < num_sequences; ++i) {
+		result[i] = random_position(i, width);
+	}
 
     return result; 
 }
 
 template <typename T>
-std::vector<T> GibbsSampler<T>::init_pwm(std::vector<int>& positions, int k, T pseudocount) 
+int GibbsSampler<T>::random_position(int seq_index, int width)
+{
+	int length { m_data.packed(seq_index).size() };
+	int site {};
+	// give up after a few draws; score() still keeps the chain off the mask
+	for (int tries {}; tries < 64; ++tries) {
+		site = random_site(length, width);
+		int position { decode_site(length, width, site).first };
+		if (!m_mask || !m_mask->masked(seq_index, position, width)) {
+			break;
+		}
+	}
+	return site;
+}
+
+template <typename T>
+int GibbsSampler<T>::random_site(int length, int k)
 {
-	/*
-	In PWM, each nucleotide increases weight by 1/(k+4*pseudo)
-	and we start with pseduo/(k+4*pseudo)
-	*/
-	T normalized_default { pseudocount / (k + 4*pseudocount) };
-    std::vector<T> pwm(4*k, normalized_default);
+	if (!m_bothStrands) {
+		return utility::rand_indices(m_gen, length, k)[0];
+	}
+	// only the length - k scored windows have a reverse complement site
+	int position { utility::rand_indices(m_gen, length - 1, k)[0] };
+	return m_gen.below(2) ? position + length - k : position;
+}
+
+template <typename T>
+Pwm<T> GibbsSampler<T>::make_pwm(int k, T pseudocount) const
+{
+	// higher-order backgrounds depend on context, so are scored per window
+	return { k, pseudocount, m_contextOrder ? std::array<T, 4> {} : m_logBackground };
+}
+
+template <typename T>
+Pwm<T> GibbsSampler<T>::init_pwm(std::vector<int>& positions, int k, T pseudocount) 
+{
+    Pwm<T> pwm { make_pwm(k, pseudocount) };
 
     assert(m_data.sequences().size() == positions.size());
-    for (int i {}; i < positions.size(); ++i) {
-		update_counts(pwm, i, positions[i], k, pseudocount);
+    for (int i {}; i < static_cast<int>(positions.size()); ++i) {
+		update_counts(pwm, i, positions[i]);
 	}
 
     return pwm;
 }
 
 template <typename T>
-std::vector<T> GibbsSampler<T>::update_pwm(std::vector<T>& pwm, 
-	std::vector<int>& positions, int k, T pseudocount, int old_withheld,
-	int new_withheld) 
+void GibbsSampler<T>::update_pwm(Pwm<T>& pwm, std::vector<int>& positions, 
+	int old_withheld, int new_withheld) 
 {
-	std::vector<T> old_pwm { pwm };
+	update_counts(pwm, old_withheld, positions[old_withheld]);
+	update_counts(pwm, new_withheld, positions[new_withheld], false);
+}
 
-	update_counts(pwm, old_withheld, positions[old_withheld], k, pseudocount);
-	update_counts(pwm, new_withheld, positions[new_withheld], k, pseudocount, false);
+template <typename T>
+void GibbsSampler<T>::update_counts(Pwm<T>& pwm, int seq_index, int start_pos, 
+	bool increment) 
+{
+	update_site(pwm, m_data.packed(seq_index), start_pos, increment);
+}
 
-	return old_pwm;
+template <typename T>
+void GibbsSampler<T>::update_site(Pwm<T>& pwm, const PackedSequence& seq, int site, 
+	bool increment) const
+{
+	auto [position, reverse] { decode_site(seq.size(), pwm.k(), site) };
+	pwm.update(seq, position, increment, reverse);
 }
 
+// O(seq_len * k)
 template <typename T>
-void GibbsSampler<T>::update_counts(std::vector<T>& pwm, int seq_index, int start_pos, 
-	int k, T pseudocount, bool increment) 
+const std::vector<T>& GibbsSampler<T>::score(Pwm<T>& pwm, int withheld) 
 {
-	T delta = (increment ? 1 : -1) * 1 / (k + 4 * pseudocount) ;
+	if (!m_mask || m_mask->claimed(withheld).empty()) {
+		return score(pwm, m_data.packed(withheld));
+	}
+
+	int k { pwm.k() };
+	auto& score { score_windows(pwm, m_data.packed(withheld)) };
 
-	const auto& seq { m_data.sequences()[seq_index].m_sequence };
-	for (int i {}; i < k; ++i) {
-		int idx { 4*i + utility::encode(seq[i+start_pos]) };
-		pwm[idx] += delta;    
+	int num_windows { m_data.packed(withheld).size() - k };
+	for (int s {}; s < (m_bothStrands ? 2 : 1); ++s) {
+		auto first { score.begin() + s * num_windows };
+		for (const auto& [begin, end] : m_mask->claimed(withheld)) {
+			std::fill(first + std::clamp(begin - k + 1, 0, num_windows),
+				first + std::clamp(end, 0, num_windows), 
+				kernels::excluded_score<T>());
+		}
 	}
+	return normalize(score);
+}
+
+template <typename T>
+const std::vector<T>& GibbsSampler<T>::score(Pwm<T>& pwm, const PackedSequence& seq) 
+{
+	return normalize(score_windows(pwm, seq));
 }
 
-// O(seq_len * k)
 template <typename T>
-std::vector<T> GibbsSampler<T>::score(std::vector<T>& pwm, int k, int withheld) 
+std::vector<T>& GibbsSampler<T>::score_windows(Pwm<T>& pwm, const PackedSequence& seq) 
 {
-	// TODO: if very slow, add thresholding, where only sample if score > some value
-    auto [num_sequences, sequence_length] { m_data.size() };
-	std::vector<T> score(sequence_length-k);
-
-	const auto& seq { m_data.sequences()[withheld].m_sequence };
-	for (int i {}; i < sequence_length-k; ++i) {  // iterate over possible starting positions
-		T tmp {};
-		for (int j { }; j < k; ++j) {  // iterates over single kmer
-			int nucleotide_encoding { utility::encode(seq[i+j]) };
-			tmp += 
-				std::log(pwm[4*j + nucleotide_encoding]) -
-				std::log(m_background[nucleotide_encoding]); 
+	int k { pwm.k() };
+	int num_windows { seq.size() - k };
+	assert(num_windows > 0);  // sequences must be longer than the motif
+
+	auto& score { m_scores };
+	score.resize(m_bothStrands ? 2*num_windows : num_windows);
+
+	m_bases.resize(seq.size());
+	for_chunks(seq.size(), [this, &seq](int, int begin, int end) {
+		seq.unpack(m_bases.data(), begin, end);
+	});
+
+	if (m_kernelK != k) {
+		m_kernel = kernels::score_kernel<T>(k, kernels::detect_isa());
+		m_bothKernel = kernels::both_strands_kernel<T>(k, kernels::detect_isa());
+		m_kernelK = k;
+	}
+
+	if (!pruning() && m_bothStrands) {
+		// reverse complement scores go to the second half of score
+		const T* strand_log_odds { pwm.strand_log_odds().data() };
+		for_chunks(num_windows, [this, &score, strand_log_odds, k, num_windows](
+			int, int begin, int end) {
+			m_bothKernel(strand_log_odds, m_bases.data() + begin, end - begin, k, 
+				score.data() + begin, score.data() + num_windows + begin);
+		});
+	}
+
+	const T* log_odds { pwm.log_odds().data() };
+	if (!pruning() && !m_bothStrands) {
+		for_chunks(num_windows, [this, &score, log_odds, k](int, int begin, int end) {
+			m_kernel(log_odds, m_bases.data() + begin, end - begin, k, 
+				score.data() + begin);
+		});
+	}
+
+	if (!pruning()) {
+		if (m_contextOrder) {
+			subtract_background(score, seq.size(), k);
 		}
+		return score;
+	}
 
-		score[i] = tmp;
+	// the pruned kernels take one strand at a time, so both strands cost 
+	// a second (mostly abandoned) pass over the bases
+	int strands { m_bothStrands ? 2 : 1 };
+	if (m_bothStrands) {
+		m_rcLogOdds.resize(4*k);
+		for (int j {}; j < k; ++j) {
+			for (int b {}; b < 4; ++b) {
+				m_rcLogOdds[4*(k - 1 - j) + utility::complement(b)] = log_odds[4*j + b];
+			}
+		}
 	}
+	m_suffixMax.assign(strands * (k + 1), 0);
+	for (int s {}; s < strands; ++s) {
+		const T* table { s ? m_rcLogOdds.data() : log_odds };
+		T* suffix_max { m_suffixMax.data() + s * (k + 1) };
+		for (int j { k - 1 }; j >= 0; --j) {
+			suffix_max[j] = suffix_max[j+1] + 
+				*std::max_element(table + 4*j, table + 4*j + 4);
+		}
+	}
+	m_chunkPruned.assign(num_chunks(num_windows), 0);
+	for_chunks(num_windows, [this, &score, log_odds, k, num_windows, strands](
+		int c, int begin, int end) {
+		for (int s {}; s < strands; ++s) {
+			m_chunkPruned[c] += kernels::score_windows_pruned(
+				s ? m_rcLogOdds.data() : log_odds, m_suffixMax.data() + s * (k + 1), 
+				m_bases.data() + begin, end - begin, k, m_pruneCutoff, 
+				score.data() + s * num_windows + begin);
+		}
+	});
+	return score;
+}
 
-	T norm_factor {
-		std::accumulate(std::next(begin(score)), end(score), *begin(score), [this](T a, T b) {
-			return this->sum_log_probs(a, b);
-		})
-	};
+template <typename T>
+const std::vector<T>& GibbsSampler<T>::normalize(std::vector<T>& score) 
+{
+	// log-sum-exp as a max and a sum of shifted exps per chunk, combined 
+	// once all chunks are done
+	int n { static_cast<int>(score.size()) };
+	int chunks { num_chunks(n) };
+	m_chunkMax.assign(chunks, std::numeric_limits<T>::lowest());
+	m_chunkSum.assign(chunks, 0);
+	for_chunks(n, [this, &score](int c, int begin, int end) {
+		T max { *std::max_element(score.begin() + begin, score.begin() + end) };
+		T sum {};
+		for (int i { begin }; i < end; ++i) {
+			sum += std::exp(score[i] - max);
+		}
+		m_chunkMax[c] = max;
+		m_chunkSum[c] = sum;
+	});
+
+	T max { *std::max_element(begin(m_chunkMax), end(m_chunkMax)) };
+	T sum {};
+	for (int c {}; c < chunks; ++c) {
+		sum += m_chunkSum[c] * std::exp(m_chunkMax[c] - max);
+	}
+	T norm_factor { max + std::log(sum) };
+
+	if (pruning()) {
+		// each pruned window scored below max - cutoff, so their summed 
+		// mass relative to the kept windows is at most
+		long pruned { std::accumulate(begin(m_chunkPruned), end(m_chunkPruned), 0L) };
+		double ratio { pruned * std::exp(static_cast<double>(max - m_pruneCutoff - norm_factor)) };
+		m_pruneReport.windows += n;
+		m_pruneReport.pruned += pruned;
+		m_pruneReport.max_error = std::max(m_pruneReport.max_error, ratio / (1 + ratio));
+	}
 
-	std::transform(begin(score), end(score), begin(score), [&norm_factor](const T& x) {
-		return std::exp(x - norm_factor);
+	for_chunks(n, [&score, norm_factor](int, int begin, int end) {
+		std::transform(score.begin() + begin, score.begin() + end, score.begin() + begin, 
+			[norm_factor](const T& x) {
+				return std::exp(x - norm_factor);
+			});
 	});
 	
 	return score;
 }
 
 template <typename T>
-int GibbsSampler<T>::sample(std::vector<T> scores) 
+int GibbsSampler<T>::sample(const std::vector<T>& scores) 
 {
-    std::random_device rand_device {};
-	std::mt19937 num_gen { rand_device() };
+	m_cdf.resize(scores.size());
+	std::partial_sum(begin(scores), end(scores), begin(m_cdf));
+
+	T draw { static_cast<T>(m_gen.canonical()) * m_cdf.back() };
+	auto it { std::upper_bound(begin(m_cdf), end(m_cdf), draw) };
 
-	std::discrete_distribution<int> discrete_distr(begin(scores), end(scores));
-	return discrete_distr(num_gen);
+	// rounding can place the draw at the very end of the CDF
+	return std::min<int>(std::distance(begin(m_cdf), it), m_cdf.size() - 1);
 }
@@ -0,0 +1,334 @@
+#pragma once
+
+#include "algorithm"
+#include "atomic"
+#include "cstdint"
+#include "future"
+#include "limits"
+#include "memory"
+#include "mutex"
+#include "stop_token"
+#include "thread"
+#include "vector"
+
+#include "convergence.hpp"
+#include "gibbs_sampler.hpp"
+#include "thread_pool.hpp"
+#include "utility.hpp"
+
+/* Asynchronous ("Hogwild") Gibbs sampler: one chain whose withheld sequences
+ * are resampled by several threads at once. PWM counts are shared atomic
+ * integers; a thread withdraws its sequence's k-mer, scores the sequence
+ * against a snapshot of the counts, and adds the sampled k-mer back, all
+ * with atomic adds and no lock on the PWM. Snapshots may miss updates other
+ * threads make while a sequence is scored; staleness() reports how many.
+ * Results depend on thread timing, so runs are not reproducible.
+ */
+template <typename T>
+class Hogwild : public GibbsSampler<T> {
+    public:
+        /* num_threads : threads resampling at once; 0 uses one per hardware
+         * thread. The calling thread is one of them.
+         */
+        Hogwild(const Data& data, unsigned num_threads = 0,
+            rng::Philox gen = rng::stream(rng::sampler_stream));
+        Hogwild(DataHandle data, unsigned num_threads = 0,
+            rng::Philox gen = rng::stream(rng::sampler_stream));
+
+        /* Iterations are single-sequence updates, as for Serial, counted
+         * across all threads. The stopping policy is consulted once per
+         * sweep (num_sequences updates) rather than after every update, so
+         * limits and stability windows are met to the sweep.
+         */
+        Result find_motifs(int k, T pseudocount) override;
+
+        /* Ends find_motifs early once stop is requested */
+        void set_stop_token(std::stop_token stop) { m_stop = stop; }
+
+        /* Replaces the stopping policy (StableConsensus by default) with a
+         * copy of policy
+         */
+        void set_policy(const StoppingPolicy& policy) { m_policy = policy.clone(); }
+
+        /* Updates by other threads that landed between a thread reading the
+         * counts and writing its own update, over the last find_motifs
+         */
+        struct Staleness
+        {
+            long updates;
+            double mean;
+            long max;
+        };
+
+        const Staleness& staleness() const { return m_staleness; }
+
+    private:
+        /* Per-thread scoring buffers and random stream */
+        class Worker : public GibbsSampler<T>
+        {
+            public:
+                Worker(const Hogwild& parent, rng::Philox gen);
+
+                /* Returns a new site for sequence seq_index under pwm */
+                int resample(Pwm<T>& pwm, int seq_index);
+
+                /* Workers only resample for their Hogwild */
+                Result find_motifs(int, T) override { return {}; }
+        };
+
+        /* State shared by the threads of one round */
+        struct Shared
+        {
+            int k;
+            std::vector<std::atomic<int>> counts;
+            std::atomic<int> total;
+            std::vector<std::atomic<int>> positions;
+            std::vector<std::atomic<bool>> busy;
+            std::atomic<long> next;
+            std::atomic<std::uint64_t> updates;
+            std::atomic<bool> done;
+
+            /* Staleness totals, added to once by each thread as it finishes */
+            std::atomic<long> staleness_sum;
+            std::atomic<long> staleness_max;
+
+            /* Guards the stopping policy; held only by the thread whose
+             * update completes a sweep, while it checks for convergence
+             */
+            std::mutex monitor;
+            Pwm<T> monitor_pwm;
+            ConsensusTracker<T> tracker;
+            Progress progress;
+        };
+
+        const unsigned m_numThreads;
+        std::stop_token m_stop {};
+        std::unique_ptr<StoppingPolicy> m_policy;
+        ThreadPool m_pool;
+        Staleness m_staleness {};
+
+        /* Adds delta to the counts of the k-mer at site of sequence seq_index */
+        void apply(Shared& shared, int seq_index, int site, int delta) const;
+
+        /* Copies the shared counts into pwm */
+        static void snapshot(Shared& shared, std::vector<int>& counts, Pwm<T>& pwm);
+
+        /* Resamples sequences until the round is done */
+        void work(Shared& shared, Worker& worker, T pseudocount);
+
+        /* Updates the round's progress after updates updates and stops it if
+         * the policy says so
+         */
+        void check(Shared& shared, std::vector<int>& counts, std::uint64_t updates);
+};
+
+template <typename T>
+Hogwild<T>::Hogwild(const Data& data, unsigned num_threads, rng::Philox gen)
+    : GibbsSampler<T>(data, gen),
+      m_numThreads { num_threads ? num_threads : std::max(1u, std::thread::hardware_concurrency()) },
+      m_policy { std::make_unique<StableConsensus>() },
+      m_pool { std::max(1u, m_numThreads - 1) }
+{
+}
+
+template <typename T>
+Hogwild<T>::Hogwild(DataHandle data, unsigned num_threads, rng::Philox gen)
+    : GibbsSampler<T>(std::move(data), gen),
+      m_numThreads { num_threads ? num_threads : std::max(1u, std::thread::hardware_concurrency()) },
+      m_policy { std::make_unique<StableConsensus>() },
+      m_pool { std::max(1u, m_numThreads - 1) }
+{
+}
+
+template <typename T>
+Hogwild<T>::Worker::Worker(const Hogwild& parent, rng::Philox gen)
+    : GibbsSampler<T>(parent.m_data, gen)
+{
+    this->set_mask(parent.mask());
+    this->set_pruning(parent.prune_cutoff());
+    this->set_both_strands(parent.both_strands());
+    this->set_background_order(parent.background_order());
+}
+
+template <typename T>
+int Hogwild<T>::Worker::resample(Pwm<T>& pwm, int seq_index)
+{
+    return this->sample(this->score(pwm, seq_index));
+}
+
+template <typename T>
+void Hogwild<T>::apply(Shared& shared, int seq_index, int site, int delta) const
+{
+    const auto seq { this->m_data.packed(seq_index) };
+    int k { shared.k };
+    auto [position, reverse] { this->decode_site(seq.size(), k, site) };
+    for (int j {}; j < k; ++j) {
+        int base { reverse ? utility::complement(seq[position + k - 1 - j]) : seq[position + j] };
+        shared.counts[4*j + base].fetch_add(delta, std::memory_order_relaxed);
+    }
+    shared.total.fetch_add(delta, std::memory_order_relaxed);
+}
+
+template <typename T>
+void Hogwild<T>::snapshot(Shared& shared, std::vector<int>& counts, Pwm<T>& pwm)
+{
+    for (std::size_t i {}; i < counts.size(); ++i) {
+        counts[i] = shared.counts[i].load(std::memory_order_relaxed);
+    }
+    pwm.assign(counts, shared.total.load(std::memory_order_relaxed));
+}
+
+template <typename T>
+void Hogwild<T>::work(Shared& shared, Worker& worker, T pseudocount)
+{
+    int num_sequences { static_cast<int>(shared.positions.size()) };
+    Pwm<T> pwm { this->make_pwm(shared.k, pseudocount) };
+    std::vector<int> counts(4 * shared.k);
+    long staleness_sum {}, staleness_max {};
+
+    while (!shared.done.load(std::memory_order_relaxed)) {
+        // round-robin like Serial, skipping sequences another thread holds
+        int i { static_cast<int>(shared.next.fetch_add(1, std::memory_order_relaxed) % num_sequences) };
+        if (shared.busy[i].exchange(true, std::memory_order_acquire)) {
+            continue;
+        }
+
+        apply(shared, i, shared.positions[i].load(std::memory_order_relaxed), -1);
+        std::uint64_t seen { shared.updates.load(std::memory_order_relaxed) };
+        // other threads' updates may land mid-copy or mid-score; the 
+        // snapshot is only as fresh as the last one to complete before it
+        snapshot(shared, counts, pwm);
+        int site { worker.resample(pwm, i) };
+        apply(shared, i, site, 1);
+        shared.positions[i].store(site, std::memory_order_relaxed);
+        shared.busy[i].store(false, std::memory_order_release);
+
+        std::uint64_t updates { shared.updates.fetch_add(1, std::memory_order_relaxed) + 1 };
+        long stale { static_cast<long>(updates - 1 - seen) };
+        staleness_sum += stale;
+        staleness_max = std::max(staleness_max, stale);
+
+        // one thread a sweep checks for convergence; the rest carry on
+        if (updates % num_sequences == 0) {
+            check(shared, counts, updates);
+        }
+    }
+
+    shared.staleness_sum.fetch_add(staleness_sum, std::memory_order_relaxed);
+    for (long max { shared.staleness_max.load(std::memory_order_relaxed) };
+        staleness_max > max && !shared.staleness_max.compare_exchange_weak(max, staleness_max,
+            std::memory_order_relaxed); ) {
+    }
+}
+
+template <typename T>
+void Hogwild<T>::check(Shared& shared, std::vector<int>& counts, std::uint64_t updates)
+{
+    std::lock_guard lock { shared.monitor };
+    auto& progress { shared.progress };
+    // a slow check can let the next sweep's overtake it
+    if (shared.done.load(std::memory_order_relaxed) || 
+        updates <= static_cast<std::uint64_t>(progress.iteration)) {
+        return;
+    }
+    snapshot(shared, counts, shared.monitor_pwm);
+    bool changed { shared.tracker.update(shared.monitor_pwm) };
+    int elapsed { static_cast<int>(updates - progress.iteration) };
+    progress.stable_iterations = changed ? 0 : progress.stable_iterations + elapsed;
+    progress.iteration = static_cast<int>(updates);
+    if (m_policy->stop(progress) || m_stop.stop_requested()) {
+        shared.done.store(true, std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+Result Hogwild<T>::find_motifs(int k, T pseudocount)
+{
+    int num_sequences { this->m_data.size().first };
+
+    Result best {};
+    best.log_likelihood = -std::numeric_limits<double>::infinity();
+    int total_iters {};
+    long updates {}, staleness_sum {}, staleness_max {};
+
+    for (int round {}; round < m_policy->rounds() && !m_stop.stop_requested(); ++round) {
+        std::vector<int> positions { this->init_positions(k) };
+        Pwm<T> pwm { this->init_pwm(positions, k, pseudocount) };
+        m_policy->reset();
+
+        Shared shared {
+            .k = k,
+            .counts = std::vector<std::atomic<int>>(4 * k),
+            .total = pwm.total(),
+            .positions = std::vector<std::atomic<int>>(num_sequences),
+            .busy = std::vector<std::atomic<bool>>(num_sequences),
+            .next = 0,
+            .updates = 0,
+            .done = false,
+            .staleness_sum = 0,
+            .staleness_max = 0,
+            .monitor = {},
+            .monitor_pwm = pwm,
+            .tracker = ConsensusTracker<T> { pwm },
+            .progress = { .num_sequences = num_sequences }
+        };
+        for (int i {}; i < 4 * k; ++i) {
+            shared.counts[i] = pwm.counts()[i];
+        }
+        for (int i {}; i < num_sequences; ++i) {
+            shared.positions[i] = positions[i];
+        }
+        // only called under the monitor lock, on its own PWM
+        shared.progress.log_likelihood = [this, &shared, &positions]() {
+            for (std::size_t i {}; i < positions.size(); ++i) {
+                positions[i] = shared.positions[i].load(std::memory_order_relaxed);
+            }
+            return static_cast<double>(this->log_likelihood(shared.monitor_pwm, positions));
+        };
+
+        rng::Philox gen { this->m_gen.split(round) };
+        std::vector<std::unique_ptr<Worker>> workers {};
+        for (unsigned t {}; t < m_numThreads; ++t) {
+            workers.push_back(std::make_unique<Worker>(*this, gen.split(t)));
+        }
+        std::vector<std::future<void>> threads {};
+        for (unsigned t { 1 }; t < m_numThreads; ++t) {
+            threads.push_back(m_pool.submit([this, &shared, &workers, t, pseudocount]() {
+                work(shared, *workers[t], pseudocount);
+            }));
+        }
+        work(shared, *workers[0], pseudocount);
+        for (auto& thread : threads) {
+            thread.get();
+        }
+
+        total_iters += shared.progress.iteration;
+        updates += shared.updates;
+        staleness_sum += shared.staleness_sum.load();
+        staleness_max = std::max(staleness_max, shared.staleness_max.load());
+
+        // every update has landed, so the counts match the final positions
+        for (int i {}; i < num_sequences; ++i) {
+            positions[i] = shared.positions[i];
+        }
+        Pwm<T> final_pwm { this->init_pwm(positions, k, pseudocount) };
+        double log_likelihood { this->log_likelihood(final_pwm, positions) };
+        if (log_likelihood > best.log_likelihood) {
+            auto [motif_id, num_correct] { this->best_match(positions, k) };
+            best = {
+                .num_correct = num_correct,
+                .consensus = final_pwm.consensus(),
+                .motif_id = motif_id,
+                .log_likelihood = log_likelihood,
+                .converged = m_policy->converged()
+            };
+            this->set_positions(best, positions, k);
+        }
+    }
+
+    best.iterations = total_iters;
+    m_staleness = {
+        updates, updates ? static_cast<double>(staleness_sum) / updates : 0, staleness_max
+    };
+    return best;
+}
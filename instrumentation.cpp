@@ -0,0 +1,35 @@
+#include "cstdlib"
+#include "new"
+
+#include "instrumentation.hpp"
+
+#ifdef INSTRUMENT
+namespace {
+    thread_local std::uint64_t t_allocations {};
+}
+
+std::uint64_t instrument::allocations()
+{
+    return t_allocations;
+}
+
+// every other non-aligned form of new and delete forwards to these
+void* operator new(std::size_t size)
+{
+    ++t_allocations;
+    if (void* ptr { std::malloc(size ? size : 1) }) {
+        return ptr;
+    }
+    throw std::bad_alloc {};
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+#endif
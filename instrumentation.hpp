@@ -0,0 +1,60 @@
+#pragma once
+
+#include "chrono"
+#include "cstdint"
+#include "utility"
+
+/* Where a find_motifs run spent its time; every field stays zero unless
+ * built with -DINSTRUMENT (make INSTRUMENT=1)
+ */
+struct Stats
+{
+    /* Cumulative time in each phase of the sampling loop */
+    std::uint64_t score_ns {};
+    std::uint64_t sample_ns {};
+    std::uint64_t update_ns {};
+    std::uint64_t convergence_ns {};
+
+    /* Heap allocations made by the sampling thread during the run */
+    std::uint64_t allocations {};
+
+    /* Iteration (counted across rounds) at which the consensus last changed */
+    int last_change {};
+};
+
+namespace instrument {
+#ifdef INSTRUMENT
+    inline constexpr bool enabled { true };
+
+    /* Number of operator new calls made by the calling thread so far */
+    std::uint64_t allocations();
+
+    /* Calls func, adding its running time to ns, and returns its result */
+    template <typename F>
+    decltype(auto) timed(std::uint64_t& ns, F&& func)
+    {
+        using clock = std::chrono::steady_clock;
+        struct Timer
+        {
+            std::uint64_t& ns;
+            clock::time_point start { clock::now() };
+            ~Timer() 
+            { 
+                ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    clock::now() - start).count(); 
+            }
+        } timer { ns };
+        return std::forward<F>(func)();
+    }
+#else
+    inline constexpr bool enabled { false };
+
+    inline std::uint64_t allocations() { return 0; }
+
+    template <typename F>
+    decltype(auto) timed(std::uint64_t&, F&& func)
+    {
+        return std::forward<F>(func)();
+    }
+#endif
+}
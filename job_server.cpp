@@ -0,0 +1,451 @@
+#include "algorithm"
+#include "atomic"
+#include "cerrno"
+#include "chrono"
+#include "condition_variable"
+#include "cstdio"
+#include "cstring"
+#include "future"
+#include "list"
+#include "memory"
+#include "sstream"
+#include "stdexcept"
+#include "stop_token"
+#include "thread"
+#include "vector"
+
+#include "sys/socket.h"
+#include "sys/un.h"
+#include "unistd.h"
+
+#include "convergence.hpp"
+#include "instrumentation.hpp"
+#include "job_server.hpp"
+#include "serial.hpp"
+
+namespace {
+    /* Jobs of one client still to be answered */
+    class Session
+    {
+        public:
+            explicit Session(std::function<void(const std::string&)> write_line)
+                : m_writeLine { std::move(write_line) } {}
+
+            void write(const std::string& line)
+            {
+                std::lock_guard lock { m_mutex };
+                m_writeLine(line);
+            }
+
+            void start()
+            {
+                std::lock_guard lock { m_mutex };
+                ++m_pending;
+            }
+
+            void finish(const std::string& line)
+            {
+                std::lock_guard lock { m_mutex };
+                m_writeLine(line);
+                if (--m_pending == 0) {
+                    m_done.notify_all();
+                }
+            }
+
+            void wait()
+            {
+                std::unique_lock lock { m_mutex };
+                m_done.wait(lock, [this]() { return m_pending == 0; });
+            }
+
+        private:
+            std::function<void(const std::string&)> m_writeLine;
+            std::mutex m_mutex;
+            std::condition_variable m_done;
+            int m_pending {};
+    };
+
+    /* A job in flight, whose chains run as separate pool tasks; the last
+     * chain to finish answers it
+     */
+    struct Task
+    {
+        Job job;
+        DataHandle data;
+        std::shared_ptr<Session> session;
+        std::chrono::steady_clock::time_point start;
+        std::stop_source stop {};
+        std::vector<Result> results;
+        std::vector<std::string> errors;
+        std::atomic<int> remaining;
+    };
+
+    std::string error_line(const std::string& id, const std::string& message)
+    {
+        return "{\"id\": " + json_string(id) + ", \"error\": " + json_string(message) + "}";
+    }
+
+    /* Returns the id of a job line, even one that does not parse */
+    std::string find_id(const std::string& line)
+    {
+        std::istringstream tokens { line };
+        for (std::string token {}; tokens >> token; ) {
+            if (token.starts_with("id=")) {
+                return token.substr(3);
+            }
+        }
+        return {};
+    }
+
+    void run_chain(Task& task, int i)
+    {
+        const Job& job { task.job };
+        rng::Philox gen { job.seed, rng::sampler_stream };
+        // a single chain matches ./serial, several match MultiStart
+        Serial<float> chain { task.data, job.chains > 1 ? gen.split(i) : gen };
+        chain.set_stop_token(task.stop.get_token());
+        chain.set_policy(StableConsensus { 200, job.iterations });
+        chain.set_both_strands(job.both_strands);
+        chain.set_background_order(job.background_order);
+
+        task.results[i] = chain.find_motifs(job.k, static_cast<float>(job.pseudocount));
+        if (task.results[i].converged) {
+            task.stop.request_stop();
+        }
+    }
+
+    void answer(Task& task)
+    {
+        const Job& job { task.job };
+        auto failed { std::find_if(begin(task.errors), end(task.errors),
+            [](const std::string& error) { return !error.empty(); }) };
+        if (failed != end(task.errors)) {
+            task.session->finish(error_line(job.id, *failed));
+            return;
+        }
+
+        const Result& best { *std::max_element(begin(task.results), end(task.results),
+            [](const Result& a, const Result& b) {
+                return a.log_likelihood < b.log_likelihood;
+            }) };
+        double wall_ms { std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - task.start).count() };
+
+        std::ostringstream line {};
+        line << "\"id\": " << json_string(job.id) << ", \"k\": " << job.k
+             << ", \"seed\": " << job.seed << ", \"chains\": " << job.chains
+             << ", \"wall_ms\": " << wall_ms << ", ";
+        std::string members { line.str() };
+        line.str({});
+        write_json(line, best, members);
+        task.session->finish(line.str());
+    }
+
+    /* Reads newline-terminated lines from a socket */
+    class SocketReader
+    {
+        public:
+            explicit SocketReader(int fd) : m_fd { fd } {}
+
+            bool operator()(std::string& line)
+            {
+                while (true) {
+                    auto newline { m_buffer.find('\n') };
+                    if (newline != std::string::npos) {
+                        line = m_buffer.substr(0, newline);
+                        m_buffer.erase(0, newline + 1);
+                        return true;
+                    }
+
+                    char chunk[4096];
+                    ssize_t bytes { ::read(m_fd, chunk, sizeof(chunk)) };
+                    if (bytes < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (bytes <= 0) {
+                        // a last line without a newline still counts
+                        line = std::move(m_buffer);
+                        m_buffer.clear();
+                        return !line.empty();
+                    }
+                    m_buffer.append(chunk, bytes);
+                }
+            }
+
+        private:
+            int m_fd;
+            std::string m_buffer {};
+    };
+
+    /* Writes line and a newline to a socket; drops it if the client has
+     * gone away
+     */
+    void write_socket(int fd, const std::string& line)
+    {
+        std::string data { line + "\n" };
+        std::size_t written {};
+        while (written < data.size()) {
+            ssize_t bytes { ::send(fd, data.data() + written, data.size() - written,
+                MSG_NOSIGNAL) };
+            if (bytes < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytes <= 0) {
+                return;
+            }
+            written += bytes;
+        }
+    }
+}
+
+Job Job::parse(std::string_view line)
+{
+    Job job {};
+    std::istringstream tokens { std::string { line } };
+    std::string token {};
+    while (tokens >> token) {
+        auto equals { token.find('=') };
+        if (equals == std::string::npos) {
+            throw std::invalid_argument { "expected key=value, got " + token };
+        }
+        std::string key { token.substr(0, equals) };
+        std::string value { token.substr(equals + 1) };
+
+        bool known { true };
+        try {
+            if (key == "id") {
+                job.id = value;
+            } else if (key == "data") {
+                job.data = value;
+            } else if (key == "k") {
+                job.k = std::stoi(value);
+            } else if (key == "pseudocount") {
+                job.pseudocount = std::stod(value);
+            } else if (key == "iterations") {
+                job.iterations = std::stoi(value);
+            } else if (key == "seed") {
+                job.seed = std::stoull(value);
+            } else if (key == "chains") {
+                job.chains = std::stoi(value);
+            } else if (key == "both_strands") {
+                job.both_strands = value == "1" || value == "true";
+            } else if (key == "background_order") {
+                job.background_order = std::stoi(value);
+            } else {
+                known = false;
+            }
+        } catch (const std::logic_error&) {
+            // std::sto* throw std::invalid_argument or std::out_of_range
+            throw std::invalid_argument { "bad value in " + token };
+        }
+        if (!known) {
+            throw std::invalid_argument { "unknown job key " + key };
+        }
+    }
+
+    if (job.k < 0 || job.pseudocount <= 0 || job.iterations < 1 ||
+        job.iterations > max_iterations || job.chains < 1 || job.chains > max_chains ||
+        job.background_order < 0 || job.background_order > Background::max_order) {
+        throw std::invalid_argument { "job value out of range" };
+    }
+    return job;
+}
+
+JobServer::JobServer(DataHandle data, int default_k, unsigned num_threads)
+    : m_data { std::move(data) },
+      m_defaultK { default_k },
+      m_pool { num_threads }
+{
+}
+
+void JobServer::serve(std::istream& in, std::ostream& out)
+{
+    serve(
+        [&in](std::string& line) { return static_cast<bool>(std::getline(in, line)); },
+        [&out](const std::string& line) { out << line << std::endl; });
+}
+
+void JobServer::serve(const std::function<bool(std::string&)>& read_line,
+    const std::function<void(const std::string&)>& write_line)
+{
+    auto session { std::make_shared<Session>(write_line) };
+    std::string line {};
+    while (read_line(line)) {
+        auto first { line.find_first_not_of(" \t\r") };
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+
+        auto task { std::make_shared<Task>() };
+        try {
+            task->job = Job::parse(line);
+            if (task->job.k == 0) {
+                task->job.k = m_defaultK;
+            }
+            if (task->job.k == 0) {
+                throw std::invalid_argument { "no motif length k" };
+            }
+            task->data = task->job.data.empty() ? m_data : dataset(task->job.data);
+            if (!task->data) {
+                throw std::invalid_argument { "no dataset" };
+            }
+            auto lengths { task->data->lengths() };
+            if (lengths.empty() || task->job.k >= *std::min_element(begin(lengths), end(lengths))) {
+                throw std::invalid_argument { "k must be shorter than every sequence" };
+            }
+            task->results.resize(task->job.chains);
+            task->errors.resize(task->job.chains);
+        } catch (const std::exception& e) {
+            session->write(error_line(find_id(line), e.what()));
+            continue;
+        }
+
+        int chains { task->job.chains };
+        task->session = session;
+        task->start = std::chrono::steady_clock::now();
+        task->remaining = chains;
+        session->start();
+        for (int i {}; i < chains; ++i) {
+            m_pool.submit([task, i]() {
+                try {
+                    run_chain(*task, i);
+                } catch (const std::exception& e) {
+                    task->errors[i] = e.what();
+                    task->stop.request_stop();
+                }
+                if (--task->remaining == 0) {
+                    answer(*task);
+                }
+            });
+        }
+    }
+    session->wait();
+}
+
+void JobServer::listen(const std::string& path)
+{
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error { "socket path too long: " + path };
+    }
+    std::strcpy(address.sun_path, path.c_str());
+
+    int listener { ::socket(AF_UNIX, SOCK_STREAM, 0) };
+    if (listener < 0) {
+        throw std::runtime_error { "cannot create socket: " + std::string { std::strerror(errno) } };
+    }
+    // a stale socket file from an earlier server would block bind
+    ::unlink(path.c_str());
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        ::listen(listener, SOMAXCONN) < 0) {
+        std::string error { std::strerror(errno) };
+        ::close(listener);
+        throw std::runtime_error { "cannot listen on " + path + ": " + error };
+    }
+
+    // finished connections are joined and dropped on the next accept, so
+    // only open ones hold a thread
+    struct Connection
+    {
+        std::atomic<bool> done {};
+        std::jthread thread {};
+    };
+    std::list<Connection> connections {};
+    while (true) {
+        int fd { ::accept(listener, nullptr, nullptr) };
+        if (fd < 0 && errno == EINTR) {
+            continue;
+        }
+        if (fd < 0) {
+            break;
+        }
+        connections.remove_if([](const Connection& connection) { return connection.done.load(); });
+        auto& connection { connections.emplace_back() };
+        connection.thread = std::jthread { [this, fd, &done = connection.done]() {
+            serve(SocketReader { fd }, [fd](const std::string& line) { write_socket(fd, line); });
+            ::close(fd);
+            done = true;
+        } };
+    }
+    ::close(listener);
+}
+
+DataHandle JobServer::dataset(const std::string& path)
+{
+    std::promise<DataHandle> load {};
+    std::shared_future<DataHandle> data {};
+    bool loading {};
+    {
+        std::lock_guard lock { m_datasetsMutex };
+        auto [entry, inserted] { m_datasets.try_emplace(path) };
+        if (inserted) {
+            entry->second = load.get_future().share();
+        }
+        data = entry->second;
+        loading = inserted;
+    }
+    if (!loading) {
+        // may wait for another job's load of it, but not behind the lock
+        return data.get();
+    }
+
+    // loaded outside the lock, so jobs on other datasets are not held up
+    try {
+        load.set_value(std::make_shared<const Data>(path));
+    } catch (...) {
+        load.set_exception(std::current_exception());
+        // a later job can retry, e.g. once the file exists
+        std::lock_guard lock { m_datasetsMutex };
+        m_datasets.erase(path);
+    }
+    return data.get();
+}
+
+void write_json(std::ostream& os, const Result& result, std::string_view members)
+{
+    const Stats& stats { result.stats };
+    os << "{" << members
+       << "\"num_correct\": " << result.num_correct
+       << ", \"motif_id\": " << result.motif_id
+       << ", \"consensus\": " << json_string(result.consensus)
+       << ", \"log_likelihood\": " << result.log_likelihood
+       << ", \"iterations\": " << result.iterations
+       << ", \"converged\": " << (result.converged ? "true" : "false")
+       << ", \"pruned_fraction\": " << result.pruned_fraction
+       << ", \"prune_error\": " << result.prune_error
+       << ", \"instrumented\": " << (instrument::enabled ? "true" : "false")
+       << ", \"score_ns\": " << stats.score_ns
+       << ", \"sample_ns\": " << stats.sample_ns
+       << ", \"update_ns\": " << stats.update_ns
+       << ", \"convergence_ns\": " << stats.convergence_ns
+       << ", \"allocations\": " << stats.allocations
+       << ", \"last_change\": " << stats.last_change
+       << ", \"positions\": [";
+    for (std::size_t i {}; i < result.positions.size(); ++i) {
+        os << (i ? ", " : "") << result.positions[i];
+    }
+    os << "], \"reverse_strand\": [";
+    for (std::size_t i {}; i < result.reverse_strand.size(); ++i) {
+        os << (i ? ", " : "") << (result.reverse_strand[i] ? "true" : "false");
+    }
+    os << "]}";
+}
+
+std::string json_string(std::string_view s)
+{
+    std::string result { "\"" };
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            result += escaped;
+        } else {
+            result += c;
+        }
+    }
+    return result + "\"";
+}
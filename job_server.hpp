@@ -0,0 +1,106 @@
+#pragma once
+
+#include "cstdint"
+#include "functional"
+#include "future"
+#include "iostream"
+#include "map"
+#include "mutex"
+#include "string"
+#include "string_view"
+
+#include "data.hpp"
+#include "gibbs_sampler.hpp"
+#include "thread_pool.hpp"
+
+/* One motif-finding request, parsed from a line of space-separated
+ * key=value tokens, e.g. "id=7 k=12 iterations=2000 seed=3 chains=4"
+ */
+struct Job
+{
+    /* Echoed back with the result so clients can match them up */
+    std::string id {};
+
+    /* Dataset cache or FASTA file; empty uses the server's dataset */
+    std::string data {};
+
+    /* 0 uses the server's default motif length */
+    int k {};
+    double pseudocount { 0.1 };
+
+    /* Iteration cap of each chain, which otherwise stops once its
+     * consensus holds for 200 iterations
+     */
+    int iterations { 10'000 };
+
+    /* Sampler seed; the same job and seed give the same result as
+     * ./serial --stop consensus --seed on the same dataset
+     */
+    std::uint64_t seed {};
+    int chains { 1 };
+    bool both_strands {};
+    int background_order {};
+
+    /* Upper limits, so one request cannot exhaust the server's memory */
+    static constexpr int max_chains { 1024 };
+    static constexpr int max_iterations { 100'000'000 };
+
+    /* Throws std::invalid_argument on unknown keys or bad values */
+    static Job parse(std::string_view line);
+};
+
+/* Long-running service that keeps datasets loaded and runs jobs from any
+ * number of clients on one shared thread pool, streaming each result back
+ * as a JSON line as soon as it is done (so not necessarily in order)
+ */
+class JobServer
+{
+    public:
+        /* data : dataset of jobs that do not name one; may be null
+         * default_k : motif length of jobs that do not give one
+         * num_threads : pool size; 0 uses one thread per hardware thread
+         */
+        JobServer(DataHandle data, int default_k = 0, unsigned num_threads = 0);
+
+        /* Reads jobs from in until EOF and writes their results to out;
+         * returns once every job read has been answered. Lines that are
+         * blank or start with '#' are skipped; bad jobs are answered with
+         * {"id": ..., "error": ...}.
+         */
+        void serve(std::istream& in, std::ostream& out);
+
+        /* Serves every connection to a Unix domain socket at path like
+         * serve(), each on its own thread. Returns only if accepting fails,
+         * once the open connections have closed.
+         * Throws std::runtime_error if the socket cannot be bound.
+         */
+        void listen(const std::string& path);
+
+    private:
+        DataHandle m_data;
+        const int m_defaultK;
+        ThreadPool m_pool;
+
+        /* Datasets loaded or being loaded for jobs, by path */
+        std::mutex m_datasetsMutex;
+        std::map<std::string, std::shared_future<DataHandle>> m_datasets;
+
+        /* Calls read_line until it returns false and write_line (from any
+         * thread, one line at a time) for every answer
+         */
+        void serve(const std::function<bool(std::string&)>& read_line,
+            const std::function<void(const std::string&)>& write_line);
+
+        /* Returns the dataset at path, loading it on first use; jobs that
+         * want it meanwhile wait for that load, others do not
+         */
+        DataHandle dataset(const std::string& path);
+};
+
+/* Writes result as a single-line JSON object, without a newline
+ * members : preformatted members to put first, each followed by ", "
+ */
+void write_json(std::ostream& os, const Result& result, std::string_view members = {});
+
+/* Returns s as a quoted JSON string */
+std::string json_string(std::string_view s);
@@ -0,0 +1,531 @@
+#include "algorithm"
+#include "array"
+#include "cstdint"
+#include "immintrin.h"
+#include "limits"
+#include "utility"
+
+#include "kernels.hpp"
+
+namespace {
+    /* Gathers, widening and reductions through the masked intrinsics with
+     * an explicit zero source. The plain ones pass GCC's _mm*_undefined_*()
+     * as the merge source, which -Wmaybe-uninitialized reports once per
+     * kernel instantiation.
+     */
+    __attribute__((target("avx2")))
+    inline __m256d gather_pd(const double* base, __m128i idx)
+    {
+        __m256d all { _mm256_castsi256_pd(_mm256_set1_epi64x(-1)) };
+        return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, idx, all, 8);
+    }
+
+    __attribute__((target("avx512f")))
+    inline __m512 gather_ps(const float* base, __m512i idx)
+    {
+        return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, idx, base, 4);
+    }
+
+    __attribute__((target("avx512f")))
+    inline __m512d gather_pd(const double* base, __m256i idx)
+    {
+        return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, idx, base, 8);
+    }
+
+    __attribute__((target("avx512f")))
+    inline __m512i widen_epu8(__m128i bytes)
+    {
+        return _mm512_maskz_cvtepu8_epi32(0xFFFF, bytes);
+    }
+
+    __attribute__((target("avx512f")))
+    inline double reduce_max(__m512d v)
+    {
+        __m256d half { _mm256_max_pd(_mm512_maskz_extractf64x4_pd(0xFF, v, 0), 
+            _mm512_maskz_extractf64x4_pd(0xFF, v, 1)) };
+        __m128d quarter { _mm_max_pd(_mm256_castpd256_pd128(half), _mm256_extractf128_pd(half, 1)) };
+        return std::max(_mm_cvtsd_f64(quarter), _mm_cvtsd_f64(_mm_unpackhi_pd(quarter, quarter)));
+    }
+
+    __attribute__((target("avx512f")))
+    inline float reduce_max(__m512 v)
+    {
+        __m512d bits { _mm512_castps_pd(v) };
+        __m256 half { _mm256_max_ps(_mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF, bits, 0)), 
+            _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF, bits, 1))) };
+        __m128 quarter { _mm_max_ps(_mm256_castps256_ps128(half), _mm256_extractf128_ps(half, 1)) };
+        quarter = _mm_max_ps(quarter, _mm_movehl_ps(quarter, quarter));
+        quarter = _mm_max_ss(quarter, _mm_shuffle_ps(quarter, quarter, 1));
+        return _mm_cvtss_f32(quarter);
+    }
+
+    template <int K>
+    __attribute__((target("avx2")))
+    int score_avx2(const float* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, float* out)
+    {
+        int i {};
+        for (; i + 8 <= num_windows; i += 8) {
+            __m256 acc { _mm256_setzero_ps() };
+            for (int j {}; j < (K ? K : k); ++j) {
+                __m128i raw { _mm_loadl_epi64(reinterpret_cast<const __m128i*>(bases + i + j)) };
+                __m256i idx { _mm256_add_epi32(_mm256_cvtepu8_epi32(raw), _mm256_set1_epi32(4*j)) };
+                acc = _mm256_add_ps(acc, _mm256_i32gather_ps(log_odds, idx, 4));
+            }
+            _mm256_storeu_ps(out + i, acc);
+        }
+        return i;
+    }
+
+    template <int K>
+    __attribute__((target("avx2")))
+    int score_avx2(const double* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, double* out)
+    {
+        int i {};
+        for (; i + 4 <= num_windows; i += 4) {
+            __m256d acc { _mm256_setzero_pd() };
+            for (int j {}; j < (K ? K : k); ++j) {
+                __m128i raw { _mm_loadu_si32(bases + i + j) };
+                __m128i idx { _mm_add_epi32(_mm_cvtepu8_epi32(raw), _mm_set1_epi32(4*j)) };
+                acc = _mm256_add_pd(acc, gather_pd(log_odds, idx));
+            }
+            _mm256_storeu_pd(out + i, acc);
+        }
+        return i;
+    }
+
+    template <int K>
+    __attribute__((target("avx512f")))
+    int score_avx512(const float* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, float* out)
+    {
+        int i {};
+        for (; i + 16 <= num_windows; i += 16) {
+            __m512 acc { _mm512_setzero_ps() };
+            for (int j {}; j < (K ? K : k); ++j) {
+                __m128i raw { _mm_loadu_si128(reinterpret_cast<const __m128i*>(bases + i + j)) };
+                __m512i idx { _mm512_add_epi32(widen_epu8(raw), _mm512_set1_epi32(4*j)) };
+                acc = _mm512_add_ps(acc, gather_ps(log_odds, idx));
+            }
+            _mm512_storeu_ps(out + i, acc);
+        }
+        return i;
+    }
+
+    template <int K>
+    __attribute__((target("avx512f")))
+    int score_avx512(const double* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, double* out)
+    {
+        int i {};
+        for (; i + 8 <= num_windows; i += 8) {
+            __m512d acc { _mm512_setzero_pd() };
+            for (int j {}; j < (K ? K : k); ++j) {
+                __m128i raw { _mm_loadl_epi64(reinterpret_cast<const __m128i*>(bases + i + j)) };
+                __m256i idx { _mm256_add_epi32(_mm256_cvtepu8_epi32(raw), _mm256_set1_epi32(4*j)) };
+                acc = _mm512_add_pd(acc, gather_pd(log_odds, idx));
+            }
+            _mm512_storeu_pd(out + i, acc);
+        }
+        return i;
+    }
+
+    template <int K>
+    __attribute__((target("avx2")))
+    int both_avx2(const float* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, float* out, float* out_rc)
+    {
+        int i {};
+        for (; i + 8 <= num_windows; i += 8) {
+            __m256 fwd { _mm256_setzero_ps() };
+            __m256 rc { _mm256_setzero_ps() };
+            for (int j {}; j < (K ? K : k); ++j) {
+                __m128i raw { _mm_loadl_epi64(reinterpret_cast<const __m128i*>(bases + i + j)) };
+                __m256i idx { _mm256_add_epi32(_mm256_cvtepu8_epi32(raw), _mm256_set1_epi32(8*j)) };
+                fwd = _mm256_add_ps(fwd, _mm256_i32gather_ps(log_odds, idx, 4));
+                rc = _mm256_add_ps(rc, _mm256_i32gather_ps(log_odds + 4, idx, 4));
+            }
+            _mm256_storeu_ps(out + i, fwd);
+            _mm256_storeu_ps(out_rc + i, rc);
+        }
+        return i;
+    }
+
+    template <int K>
+    __attribute__((target("avx2")))
+    int both_avx2(const double* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, double* out, double* out_rc)
+    {
+        int i {};
+        for (; i + 4 <= num_windows; i += 4) {
+            __m256d fwd { _mm256_setzero_pd() };
+            __m256d rc { _mm256_setzero_pd() };
+            for (int j {}; j < (K ? K : k); ++j) {
+                __m128i raw { _mm_loadu_si32(bases + i + j) };
+                __m128i idx { _mm_add_epi32(_mm_cvtepu8_epi32(raw), _mm_set1_epi32(8*j)) };
+                fwd = _mm256_add_pd(fwd, gather_pd(log_odds, idx));
+                rc = _mm256_add_pd(rc, gather_pd(log_odds + 4, idx));
+            }
+            _mm256_storeu_pd(out + i, fwd);
+            _mm256_storeu_pd(out_rc + i, rc);
+        }
+        return i;
+    }
+
+    template <int K>
+    __attribute__((target("avx512f")))
+    int both_avx512(const float* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, float* out, float* out_rc)
+    {
+        int i {};
+        for (; i + 16 <= num_windows; i += 16) {
+            __m512 fwd { _mm512_setzero_ps() };
+            __m512 rc { _mm512_setzero_ps() };
+            for (int j {}; j < (K ? K : k); ++j) {
+                __m128i raw { _mm_loadu_si128(reinterpret_cast<const __m128i*>(bases + i + j)) };
+                __m512i idx { _mm512_add_epi32(widen_epu8(raw), _mm512_set1_epi32(8*j)) };
+                fwd = _mm512_add_ps(fwd, gather_ps(log_odds, idx));
+                rc = _mm512_add_ps(rc, gather_ps(log_odds + 4, idx));
+            }
+            _mm512_storeu_ps(out + i, fwd);
+            _mm512_storeu_ps(out_rc + i, rc);
+        }
+        return i;
+    }
+
+    template <int K>
+    __attribute__((target("avx512f")))
+    int both_avx512(const double* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, double* out, double* out_rc)
+    {
+        int i {};
+        for (; i + 8 <= num_windows; i += 8) {
+            __m512d fwd { _mm512_setzero_pd() };
+            __m512d rc { _mm512_setzero_pd() };
+            for (int j {}; j < (K ? K : k); ++j) {
+                __m128i raw { _mm_loadl_epi64(reinterpret_cast<const __m128i*>(bases + i + j)) };
+                __m256i idx { _mm256_add_epi32(_mm256_cvtepu8_epi32(raw), _mm256_set1_epi32(8*j)) };
+                fwd = _mm512_add_pd(fwd, gather_pd(log_odds, idx));
+                rc = _mm512_add_pd(rc, gather_pd(log_odds + 4, idx));
+            }
+            _mm512_storeu_pd(out + i, fwd);
+            _mm512_storeu_pd(out_rc + i, rc);
+        }
+        return i;
+    }
+
+    /* Positions scored between checks of whether a group can be abandoned */
+    constexpr int prune_interval { 4 };
+
+    __attribute__((target("avx2")))
+    int pruned_avx2(const float* log_odds, const float* suffix_max, 
+        const std::uint8_t* bases, int num_windows, int k, float cutoff, float* out, 
+        float& best, int& pruned)
+    {
+        int i {};
+        for (; i + 8 <= num_windows; i += 8) {
+            __m256 threshold { _mm256_set1_ps(best - cutoff) };
+            __m256 acc { _mm256_setzero_ps() };
+            int j {};
+            while (j < k) {
+                for (int stop { std::min(j + prune_interval, k) }; j < stop; ++j) {
+                    __m128i raw { _mm_loadl_epi64(reinterpret_cast<const __m128i*>(bases + i + j)) };
+                    __m256i idx { _mm256_add_epi32(_mm256_cvtepu8_epi32(raw), _mm256_set1_epi32(4*j)) };
+                    acc = _mm256_add_ps(acc, _mm256_i32gather_ps(log_odds, idx, 4));
+                }
+                __m256 bound { _mm256_add_ps(acc, _mm256_set1_ps(suffix_max[j])) };
+                if (j < k && !_mm256_movemask_ps(_mm256_cmp_ps(bound, threshold, _CMP_GE_OQ))) {
+                    break;
+                }
+            }
+            if (j < k) {
+                _mm256_storeu_ps(out + i, _mm256_set1_ps(kernels::excluded_score<float>()));
+                pruned += 8;
+            } else {
+                _mm256_storeu_ps(out + i, acc);
+                best = std::max(best, *std::max_element(out + i, out + i + 8));
+            }
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2")))
+    int pruned_avx2(const double* log_odds, const double* suffix_max, 
+        const std::uint8_t* bases, int num_windows, int k, double cutoff, double* out, 
+        double& best, int& pruned)
+    {
+        int i {};
+        for (; i + 4 <= num_windows; i += 4) {
+            __m256d threshold { _mm256_set1_pd(best - cutoff) };
+            __m256d acc { _mm256_setzero_pd() };
+            int j {};
+            while (j < k) {
+                for (int stop { std::min(j + prune_interval, k) }; j < stop; ++j) {
+                    __m128i raw { _mm_loadu_si32(bases + i + j) };
+                    __m128i idx { _mm_add_epi32(_mm_cvtepu8_epi32(raw), _mm_set1_epi32(4*j)) };
+                    acc = _mm256_add_pd(acc, gather_pd(log_odds, idx));
+                }
+                __m256d bound { _mm256_add_pd(acc, _mm256_set1_pd(suffix_max[j])) };
+                if (j < k && !_mm256_movemask_pd(_mm256_cmp_pd(bound, threshold, _CMP_GE_OQ))) {
+                    break;
+                }
+            }
+            if (j < k) {
+                _mm256_storeu_pd(out + i, _mm256_set1_pd(kernels::excluded_score<double>()));
+                pruned += 4;
+            } else {
+                _mm256_storeu_pd(out + i, acc);
+                best = std::max(best, *std::max_element(out + i, out + i + 4));
+            }
+        }
+        return i;
+    }
+
+    __attribute__((target("avx512f")))
+    int pruned_avx512(const float* log_odds, const float* suffix_max, 
+        const std::uint8_t* bases, int num_windows, int k, float cutoff, float* out, 
+        float& best, int& pruned)
+    {
+        int i {};
+        for (; i + 16 <= num_windows; i += 16) {
+            __m512 threshold { _mm512_set1_ps(best - cutoff) };
+            __m512 acc { _mm512_setzero_ps() };
+            int j {};
+            while (j < k) {
+                for (int stop { std::min(j + prune_interval, k) }; j < stop; ++j) {
+                    __m128i raw { _mm_loadu_si128(reinterpret_cast<const __m128i*>(bases + i + j)) };
+                    __m512i idx { _mm512_add_epi32(widen_epu8(raw), _mm512_set1_epi32(4*j)) };
+                    acc = _mm512_add_ps(acc, gather_ps(log_odds, idx));
+                }
+                __m512 bound { _mm512_add_ps(acc, _mm512_set1_ps(suffix_max[j])) };
+                if (j < k && !_mm512_cmp_ps_mask(bound, threshold, _CMP_GE_OQ)) {
+                    break;
+                }
+            }
+            if (j < k) {
+                _mm512_storeu_ps(out + i, _mm512_set1_ps(kernels::excluded_score<float>()));
+                pruned += 16;
+            } else {
+                _mm512_storeu_ps(out + i, acc);
+                best = std::max(best, reduce_max(acc));
+            }
+        }
+        return i;
+    }
+
+    __attribute__((target("avx512f")))
+    int pruned_avx512(const double* log_odds, const double* suffix_max, 
+        const std::uint8_t* bases, int num_windows, int k, double cutoff, double* out, 
+        double& best, int& pruned)
+    {
+        int i {};
+        for (; i + 8 <= num_windows; i += 8) {
+            __m512d threshold { _mm512_set1_pd(best - cutoff) };
+            __m512d acc { _mm512_setzero_pd() };
+            int j {};
+            while (j < k) {
+                for (int stop { std::min(j + prune_interval, k) }; j < stop; ++j) {
+                    __m128i raw { _mm_loadl_epi64(reinterpret_cast<const __m128i*>(bases + i + j)) };
+                    __m256i idx { _mm256_add_epi32(_mm256_cvtepu8_epi32(raw), _mm256_set1_epi32(4*j)) };
+                    acc = _mm512_add_pd(acc, gather_pd(log_odds, idx));
+                }
+                __m512d bound { _mm512_add_pd(acc, _mm512_set1_pd(suffix_max[j])) };
+                if (j < k && !_mm512_cmp_pd_mask(bound, threshold, _CMP_GE_OQ)) {
+                    break;
+                }
+            }
+            if (j < k) {
+                _mm512_storeu_pd(out + i, _mm512_set1_pd(kernels::excluded_score<double>()));
+                pruned += 8;
+            } else {
+                _mm512_storeu_pd(out + i, acc);
+                best = std::max(best, reduce_max(acc));
+            }
+        }
+        return i;
+    }
+
+    template <typename T>
+    int pruned_dispatch(const T* log_odds, const T* suffix_max, 
+        const std::uint8_t* bases, int num_windows, int k, T cutoff, T* out, 
+        kernels::Isa isa)
+    {
+        T best { std::numeric_limits<T>::lowest() };
+        int pruned {};
+        int done {};
+        switch (isa) {
+            case kernels::Isa::avx512:
+                done = pruned_avx512(log_odds, suffix_max, bases, num_windows, k, cutoff, 
+                    out, best, pruned);
+                break;
+            case kernels::Isa::avx2:
+                done = pruned_avx2(log_odds, suffix_max, bases, num_windows, k, cutoff, 
+                    out, best, pruned);
+                break;
+            case kernels::Isa::scalar:
+                break;
+        }
+        return pruned + kernels::score_windows_pruned_scalar(log_odds, suffix_max, 
+            bases + done, num_windows - done, k, cutoff, out + done, best);
+    }
+
+    /* Vector kernel for isa, then the scalar loop for the remainder */
+    template <int K, kernels::Isa I, typename T>
+    void score_fixed(const T* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, T* out)
+    {
+        int done {};
+        if constexpr (I == kernels::Isa::avx512) {
+            done = score_avx512<K>(log_odds, bases, num_windows, k, out);
+        } else if constexpr (I == kernels::Isa::avx2) {
+            done = score_avx2<K>(log_odds, bases, num_windows, k, out);
+        }
+        kernels::score_windows_scalar<K>(log_odds, bases + done, num_windows - done, 
+            k, out + done);
+    }
+
+    template <int K, kernels::Isa I, typename T>
+    void both_fixed(const T* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, T* out, T* out_rc)
+    {
+        int done {};
+        if constexpr (I == kernels::Isa::avx512) {
+            done = both_avx512<K>(log_odds, bases, num_windows, k, out, out_rc);
+        } else if constexpr (I == kernels::Isa::avx2) {
+            done = both_avx2<K>(log_odds, bases, num_windows, k, out, out_rc);
+        }
+        kernels::score_both_strands_scalar<K>(log_odds, bases + done, 
+            num_windows - done, k, out + done, out_rc + done);
+    }
+
+    /* Kernels for k = min_fixed_k + Ks */
+    template <kernels::Isa I, typename T, int... Ks>
+    constexpr auto make_table(std::integer_sequence<int, Ks...>)
+    {
+        return std::array<kernels::ScoreFn<T>, sizeof...(Ks)> { 
+            &score_fixed<kernels::min_fixed_k + Ks, I, T>... 
+        };
+    }
+
+    template <kernels::Isa I, typename T, int... Ks>
+    constexpr auto make_both_table(std::integer_sequence<int, Ks...>)
+    {
+        return std::array<kernels::BothStrandsFn<T>, sizeof...(Ks)> { 
+            &both_fixed<kernels::min_fixed_k + Ks, I, T>... 
+        };
+    }
+
+    using FixedKs = std::make_integer_sequence<int, 
+        kernels::max_fixed_k - kernels::min_fixed_k + 1>;
+
+    template <kernels::Isa I, typename T>
+    constexpr auto fixed_table { make_table<I, T>(FixedKs {}) };
+
+    template <kernels::Isa I, typename T>
+    constexpr auto both_table { make_both_table<I, T>(FixedKs {}) };
+
+    template <typename T>
+    kernels::ScoreFn<T> select_kernel(int k, kernels::Isa isa)
+    {
+        using kernels::Isa;
+        bool fixed { k >= kernels::min_fixed_k && k <= kernels::max_fixed_k };
+        int i { k - kernels::min_fixed_k };
+        switch (isa) {
+            case Isa::avx512:
+                return fixed ? fixed_table<Isa::avx512, T>[i] : &score_fixed<0, Isa::avx512, T>;
+            case Isa::avx2:
+                return fixed ? fixed_table<Isa::avx2, T>[i] : &score_fixed<0, Isa::avx2, T>;
+            case Isa::scalar:
+                break;
+        }
+        return fixed ? fixed_table<Isa::scalar, T>[i] : &score_fixed<0, Isa::scalar, T>;
+    }
+
+    template <typename T>
+    kernels::BothStrandsFn<T> select_both_kernel(int k, kernels::Isa isa)
+    {
+        using kernels::Isa;
+        bool fixed { k >= kernels::min_fixed_k && k <= kernels::max_fixed_k };
+        int i { k - kernels::min_fixed_k };
+        switch (isa) {
+            case Isa::avx512:
+                return fixed ? both_table<Isa::avx512, T>[i] : &both_fixed<0, Isa::avx512, T>;
+            case Isa::avx2:
+                return fixed ? both_table<Isa::avx2, T>[i] : &both_fixed<0, Isa::avx2, T>;
+            case Isa::scalar:
+                break;
+        }
+        return fixed ? both_table<Isa::scalar, T>[i] : &both_fixed<0, Isa::scalar, T>;
+    }
+}
+
+kernels::Isa kernels::detect_isa()
+{
+    static const Isa isa { []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return Isa::avx512;
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            return Isa::avx2;
+        }
+        return Isa::scalar;
+    }() };
+    return isa;
+}
+
+bool kernels::supports(Isa isa)
+{
+    return static_cast<int>(isa) <= static_cast<int>(detect_isa());
+}
+
+template <>
+kernels::ScoreFn<float> kernels::score_kernel<float>(int k, Isa isa)
+{
+    return select_kernel<float>(k, isa);
+}
+
+template <>
+kernels::ScoreFn<double> kernels::score_kernel<double>(int k, Isa isa)
+{
+    return select_kernel<double>(k, isa);
+}
+
+template <>
+kernels::BothStrandsFn<float> kernels::both_strands_kernel<float>(int k, Isa isa)
+{
+    return select_both_kernel<float>(k, isa);
+}
+
+template <>
+kernels::BothStrandsFn<double> kernels::both_strands_kernel<double>(int k, Isa isa)
+{
+    return select_both_kernel<double>(k, isa);
+}
+
+void kernels::score_windows(const float* log_odds, const std::uint8_t* bases, 
+    int num_windows, int k, float* out, Isa isa)
+{
+    score_kernel<float>(k, isa)(log_odds, bases, num_windows, k, out);
+}
+
+void kernels::score_windows(const double* log_odds, const std::uint8_t* bases, 
+    int num_windows, int k, double* out, Isa isa)
+{
+    score_kernel<double>(k, isa)(log_odds, bases, num_windows, k, out);
+}
+
+int kernels::score_windows_pruned(const float* log_odds, const float* suffix_max, 
+    const std::uint8_t* bases, int num_windows, int k, float cutoff, float* out, 
+    Isa isa)
+{
+    return pruned_dispatch(log_odds, suffix_max, bases, num_windows, k, cutoff, out, isa);
+}
+
+int kernels::score_windows_pruned(const double* log_odds, const double* suffix_max, 
+    const std::uint8_t* bases, int num_windows, int k, double cutoff, double* out, 
+    Isa isa)
+{
+    return pruned_dispatch(log_odds, suffix_max, bases, num_windows, k, cutoff, out, isa);
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "algorithm"
+#include "cstdint"
+#include "limits"
+
+namespace kernels {
+    /* Instruction sets with a dedicated window scoring kernel */
+    enum class Isa { scalar, avx2, avx512 };
+
+    /* Returns the widest Isa supported by the running CPU (cached) */
+    Isa detect_isa();
+
+    /* Returns true if the running CPU can execute kernels for isa */
+    bool supports(Isa isa);
+
+    /* Motif lengths with kernels unrolled at compile time */
+    inline constexpr int min_fixed_k { 6 };
+    inline constexpr int max_fixed_k { 32 };
+
+    /* Scores num_windows consecutive k-mers against a log-odds table
+     * log_odds : 4*k entries laid out like the PWM
+     * bases : nucleotide encodings in {0, 1, 2, 3}, at least num_windows+k-1 long
+     * out : receives the summed log-odds of the window starting at each index
+     * K : k fixed at compile time, so the inner loop is unrolled; 0 uses k
+     */
+    template <int K = 0, typename T>
+    void score_windows_scalar(const T* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, T* out)
+    {
+        for (int i {}; i < num_windows; ++i) {
+            T tmp {};
+            for (int j {}; j < (K ? K : k); ++j) {
+                tmp += log_odds[4*j + bases[i+j]];
+            }
+            out[i] = tmp;
+        }
+    }
+
+    /* Scores num_windows consecutive k-mers on both strands in one pass
+     * strand_log_odds : 8*k entries; entry 8*j + b is the forward log-odds
+     * of base b at column j and entry 8*j + 4 + b that of the reverse 
+     * complement PWM, so each base loaded indexes both halves
+     * out, out_rc : receive the forward and reverse complement score of the
+     * window starting at each index
+     */
+    template <int K = 0, typename T>
+    void score_both_strands_scalar(const T* strand_log_odds, 
+        const std::uint8_t* bases, int num_windows, int k, T* out, T* out_rc)
+    {
+        for (int i {}; i < num_windows; ++i) {
+            T fwd {};
+            T rc {};
+            for (int j {}; j < (K ? K : k); ++j) {
+                const T* column { strand_log_odds + 8*j + bases[i+j] };
+                fwd += column[0];
+                rc += column[4];
+            }
+            out[i] = fwd;
+            out_rc[i] = rc;
+        }
+    }
+
+    /* Score given to windows that must get zero probability. Finite, unlike
+     * -inf which -ffast-math assumes never occurs, and far enough from 
+     * lowest() that subtracting a normalizer cannot overflow to -inf (exp 
+     * of which takes a slow path)
+     */
+    template <typename T>
+    constexpr T excluded_score()
+    {
+        return std::numeric_limits<T>::lowest() / 2;
+    }
+
+    /* Branch-and-bound variant of score_windows_scalar
+     * suffix_max : k+1 entries; suffix_max[j] is the highest score positions
+     * [j, k) can add, so suffix_max[k] == 0
+     * best : highest full window score seen so far; updated
+     * A window is abandoned as soon as its prefix plus suffix_max cannot 
+     * come within cutoff of best; its out entry is set to excluded_score().
+     * Returns the number abandoned. Every abandoned window scores below 
+     * the final best - cutoff.
+     */
+    template <typename T>
+    int score_windows_pruned_scalar(const T* log_odds, const T* suffix_max, 
+        const std::uint8_t* bases, int num_windows, int k, T cutoff, T* out, 
+        T& best)
+    {
+        int pruned {};
+        for (int i {}; i < num_windows; ++i) {
+            T threshold { best - cutoff };
+            T tmp {};
+            int j {};
+            for (; j < k; ++j) {
+                tmp += log_odds[4*j + bases[i+j]];
+                if (tmp + suffix_max[j+1] < threshold) {
+                    break;
+                }
+            }
+            if (j < k) {
+                out[i] = excluded_score<T>();
+                ++pruned;
+            } else {
+                out[i] = tmp;
+                best = std::max(best, tmp);
+            }
+        }
+        return pruned;
+    }
+
+    /* Runtime-dispatched pruned kernels: the vector kernels score 8/16 
+     * (float) or 4/8 (double) windows together and abandon the group once
+     * none of them can reach the cutoff, checking every few positions; 
+     * windows of a surviving group are scored in full. 
+     * best starts at the lowest T.
+     */
+    int score_windows_pruned(const float* log_odds, const float* suffix_max, 
+        const std::uint8_t* bases, int num_windows, int k, float cutoff, 
+        float* out, Isa isa = detect_isa());
+    int score_windows_pruned(const double* log_odds, const double* suffix_max, 
+        const std::uint8_t* bases, int num_windows, int k, double cutoff, 
+        double* out, Isa isa = detect_isa());
+
+    template <typename T>
+    int score_windows_pruned(const T* log_odds, const T* suffix_max, 
+        const std::uint8_t* bases, int num_windows, int k, T cutoff, T* out, 
+        Isa = Isa::scalar)
+    {
+        T best { std::numeric_limits<T>::lowest() };
+        return score_windows_pruned_scalar(log_odds, suffix_max, bases, num_windows, 
+            k, cutoff, out, best);
+    }
+
+    template <typename T>
+    using ScoreFn = void (*)(const T* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, T* out);
+
+    /* Returns the kernel for k-mers on isa, looked up in a table of kernels
+     * specialized for every k in [min_fixed_k, max_fixed_k]; other lengths 
+     * get the generic kernel. Resolve once per motif length and reuse.
+     */
+    template <typename T>
+    ScoreFn<T> score_kernel(int, Isa = Isa::scalar)
+    {
+        return &score_windows_scalar<0, T>;
+    }
+
+    template <>
+    ScoreFn<float> score_kernel<float>(int k, Isa isa);
+    template <>
+    ScoreFn<double> score_kernel<double>(int k, Isa isa);
+
+    template <typename T>
+    using BothStrandsFn = void (*)(const T* strand_log_odds, 
+        const std::uint8_t* bases, int num_windows, int k, T* out, T* out_rc);
+
+    /* Like score_kernel, for score_both_strands_scalar; the vector kernels
+     * gather both strands' entries with the same indices
+     */
+    template <typename T>
+    BothStrandsFn<T> both_strands_kernel(int, Isa = Isa::scalar)
+    {
+        return &score_both_strands_scalar<0, T>;
+    }
+
+    template <>
+    BothStrandsFn<float> both_strands_kernel<float>(int k, Isa isa);
+    template <>
+    BothStrandsFn<double> both_strands_kernel<double>(int k, Isa isa);
+
+    /* Runtime-dispatched kernels: score 8/16 windows at once for float and
+     * 4/8 for double, falling back to the scalar loop for the remainder.
+     * Accumulation order matches score_windows_scalar.
+     */
+    void score_windows(const float* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, float* out, Isa isa = detect_isa());
+    void score_windows(const double* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, double* out, Isa isa = detect_isa());
+
+    /* No vector kernel for other types (e.g. long double) */
+    template <typename T>
+    void score_windows(const T* log_odds, const std::uint8_t* bases, 
+        int num_windows, int k, T* out, Isa = Isa::scalar)
+    {
+        score_windows_scalar(log_odds, bases, num_windows, k, out);
+    }
+}
@@ -1,31 +1,261 @@
+#include "algorithm"
+#include "block_store.hpp"
+#include "chrono"
+#include "convergence.hpp"
+#include "cstdint"
 #include "data.hpp"
 #include "gibbs_sampler.hpp"
+#include "hogwild.hpp"
 #include "iostream"
+#include "job_server.hpp"
+#include "memory"
+#include "mpi.hpp"
+#include "multi_motif.hpp"
+#include "multi_start.hpp"
+#include "rng.hpp"
 #include "serial.hpp"
+#include "set"
+#include "streaming.hpp"
 #include "string"
+#include "thread_pool.hpp"
 #include "vector"
 
-int main(int argc, char* argv[]) {
-    if (argc < 5) {
-        std::cerr << "Usage: " << argv[0]
-                  << " <num_motifs> <motif_lengths> <num_sequences> "
-                     "<sequence_length>\n";
-        return 1;
+namespace {
+struct Options {
+    std::vector<std::string> args{};
+    int num_chains{1};
+    unsigned num_threads{0};
+    std::string fasta_path{};
+    std::string store_path{};
+    std::string write_store_path{};
+    std::string data_path{};
+    std::string write_data_path{};
+    std::size_t budget_mb{256};
+    std::size_t block_mb{16};
+    int k{};
+    std::string stop{"fixed"};
+    int max_iters{10'000};
+    int window{200};
+    double tolerance{1e-3};
+    int rounds{1};
+    int num_motifs{1};
+    unsigned score_threads{1};
+    unsigned hogwild_threads{0};
+    bool json{false};
+    double prune{0};
+    bool both_strands{false};
+    int background_order{0};
+    double mutation_rate{0};
+    bool serve{false};
+    std::string socket_path{};
+
+    /* Every --flag given, to reject those the chosen mode would ignore */
+    std::set<std::string> given{};
+};
+
+/* Returns false if argv is not a valid command line */
+bool parse(int argc, char* argv[], Options& options) {
+    for (int i{1}; i < argc; ++i) {
+        std::string arg{argv[i]};
+        bool has_value{i + 1 < argc};
+        if (arg.starts_with("--")) {
+            options.given.insert(arg);
+        }
+        if (arg == "--seed" && has_value) {
+            rng::set_seed(std::stoull(argv[++i]));
+        } else if (arg == "--chains" && has_value) {
+            options.num_chains = std::stoi(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            options.num_threads = std::stoul(argv[++i]);
+        } else if (arg == "--fasta" && has_value) {
+            options.fasta_path = argv[++i];
+        } else if (arg == "--store" && has_value) {
+            options.store_path = argv[++i];
+        } else if (arg == "--write-store" && has_value) {
+            options.write_store_path = argv[++i];
+        } else if (arg == "--data" && has_value) {
+            options.data_path = argv[++i];
+        } else if (arg == "--write-data" && has_value) {
+            options.write_data_path = argv[++i];
+        } else if (arg == "--budget-mb" && has_value) {
+            options.budget_mb = std::stoul(argv[++i]);
+        } else if (arg == "--block-mb" && has_value) {
+            options.block_mb = std::stoul(argv[++i]);
+        } else if (arg == "--k" && has_value) {
+            options.k = std::stoi(argv[++i]);
+        } else if (arg == "--stop" && has_value) {
+            options.stop = argv[++i];
+        } else if (arg == "--max-iters" && has_value) {
+            options.max_iters = std::stoi(argv[++i]);
+        } else if (arg == "--window" && has_value) {
+            options.window = std::stoi(argv[++i]);
+        } else if (arg == "--tolerance" && has_value) {
+            options.tolerance = std::stod(argv[++i]);
+        } else if (arg == "--rounds" && has_value) {
+            options.rounds = std::stoi(argv[++i]);
+        } else if (arg == "--score-threads" && has_value) {
+            options.score_threads = std::stoul(argv[++i]);
+        } else if (arg == "--hogwild" && has_value) {
+            options.hogwild_threads = std::stoul(argv[++i]);
+        } else if (arg == "--prune" && has_value) {
+            options.prune = std::stod(argv[++i]);
+        } else if (arg == "--mutation-rate" && has_value) {
+            options.mutation_rate = std::stod(argv[++i]);
+        } else if (arg == "--background-order" && has_value) {
+            options.background_order = std::stoi(argv[++i]);
+        } else if (arg == "--both-strands") {
+            options.both_strands = true;
+        } else if (arg == "--serve") {
+            options.serve = true;
+        } else if (arg == "--socket" && has_value) {
+            options.serve = true;
+            options.socket_path = argv[++i];
+        } else if (arg == "--json") {
+            options.json = true;
+        } else if (arg == "--motifs" && has_value) {
+            options.num_motifs = std::stoi(argv[++i]);
+        } else {
+            options.args.push_back(arg);
+        }
+    }
+
+    if (options.num_motifs < 1) {
+        return false;
+    }
+    if (options.hogwild_threads > 0 && options.num_chains > 1) {
+        return false;
+    }
+    if (options.background_order < 0 ||
+        options.background_order > Background::max_order) {
+        return false;
+    }
+    if (options.stop != "fixed" && options.stop != "consensus" &&
+        options.stop != "likelihood") {
+        return false;
+    }
+    bool has_input{!options.fasta_path.empty() || !options.data_path.empty()};
+    if (options.serve) {
+        // jobs may name their own datasets, so the server needs none
+        return has_input || options.args.empty() || options.args.size() >= 4;
+    }
+    if (has_input && (!options.write_store_path.empty() ||
+                      !options.write_data_path.empty())) {
+        return true;
+    }
+    if (has_input || !options.store_path.empty()) {
+        return options.k > 0;
+    }
+    return options.args.size() >= 4;
+}
+
+/* Returns an error naming an option the chosen mode would otherwise
+ * silently ignore, or an empty string if there is none
+ */
+std::string unsupported_option(const Options& options) {
+    auto first_given = [&options](std::initializer_list<const char*> flags) {
+        for (const char* flag : flags) {
+            if (options.given.contains(flag)) {
+                return std::string{flag};
+            }
+        }
+        return std::string{};
+    };
+#ifdef MPI
+    // Mpi runs fixed or consensus stopping over whole sweeps
+    if (options.stop == "likelihood") {
+        return "--stop likelihood is not supported with MPI";
     }
+    std::string flag{first_given({"--tolerance", "--rounds", "--hogwild",
+                                  "--serve", "--socket", "--store"})};
+    return flag.empty() ? flag : flag + " is not supported with MPI";
+#else
+    if (options.store_path.empty()) {
+        return {};
+    }
+    // the streaming sampler runs a fixed number of sweeps over the store
+    if (options.stop != "fixed") {
+        return "--stop " + options.stop + " is not supported with --store";
+    }
+    std::string flag{first_given({"--window", "--tolerance", "--rounds",
+                                  "--background-order", "--hogwild",
+                                  "--chains", "--motifs"})};
+    return flag.empty() ? flag : flag + " is not supported with --store";
+#endif
+}
 
-    int num_m = std::stoi(argv[1]);
-    int m_len = std::stoi(argv[2]);
-    int num_s = std::stoi(argv[3]);
-    int s_len = std::stoi(argv[4]);
-    std::vector<int> motif_lengths(num_m, m_len);
-    int num_sequences{num_s};
-    int sequence_length{s_len};
+void print_usage(const char* program) {
+    std::string common{
+        " [--seed <seed>] [--chains <n> [--threads <n>]] [--motifs <n>] "};
+    std::cerr << "Usage: " << program << common
+              << "<num_motifs> <motif_lengths> <num_sequences> "
+                 "<sequence_length>\n"
+              << "       " << program << common
+              << "(--fasta | --data) <path> --k <motif_length>\n"
+              << "       " << program
+              << " [--seed <seed>] --store <path> --k <motif_length> "
+                 "[--budget-mb <n>]\n"
+              << "       " << program
+              << " --write-store <path> [--block-mb <n>] "
+                 "(--fasta <path> | <num_motifs> ...)\n"
+              << "       " << program
+              << " --write-data <path> (--fasta <path> | <num_motifs> ...)\n"
+              << "       " << program
+              << " (--serve | --socket <path>) [--threads <n>] "
+                 "[(--fasta | --data) <path> [--k <n>] | <num_motifs> ...]\n"
+              << "Stopping: [--stop fixed|consensus|likelihood] "
+                 "[--max-iters <n>] [--window <n>] [--tolerance <x>] "
+                 "[--rounds <n>]\n"
+              << "  --serve reads jobs of key=value tokens (id, data, k, "
+                 "pseudocount, iterations, seed, chains, both_strands, "
+                 "background_order) from stdin, or each connection to "
+                 "--socket, and answers each with a JSON line\n"
+              << "  --fasta skips every base other than A, C, G and T (such as "
+                 "N), and k must be shorter than every record\n"
+              << "  --write-data saves the dataset as a binary cache, which "
+                 "--data maps back in without parsing\n"
+              << "  --motifs finds n motifs of length k in one run, masking "
+                 "each one from the searches after it\n"
+              << "  --json prints each result as one JSON object, with "
+                 "per-phase timings when built with INSTRUMENT=1\n"
+              << "  --mutation-rate <p> replaces each base of an embedded "
+                 "motif with probability p\n"
+              << "  --both-strands also scans the reverse complement of "
+                 "every sequence\n"
+              << "  --background-order <m> weighs each base against its "
+                 "frequency after the m bases before it\n"
+              << "  --prune <nats> skips windows scoring more than nats "
+                 "below the best so far\n"
+              << "  --hogwild <n> resamples n sequences of one chain at "
+                 "once against shared counts, reporting how stale they were\n"
+              << "  --score-threads <n> splits scoring of long sequences "
+                 "across n threads\n"
+              << "  --stop defaults to fixed, exactly --max-iters iterations; "
+                 "consensus and likelihood stop early once converged\n"
+              << "  --window is iterations of unchanged consensus, or sweeps "
+                 "without a likelihood gain above --tolerance\n";
+}
 
-    Data data{motif_lengths, num_sequences, sequence_length};
-    std::cout << data << std::endl;
+#ifndef MPI
+/* Builds the stopping policy selected on the command line */
+std::unique_ptr<StoppingPolicy> make_policy(const Options& options) {
+    std::unique_ptr<StoppingPolicy> policy{};
+    if (options.stop == "fixed") {
+        policy = std::make_unique<FixedIterations>(options.max_iters);
+    } else if (options.stop == "likelihood") {
+        policy = std::make_unique<LikelihoodPlateau>(
+            options.window, options.tolerance, options.max_iters);
+    } else {
+        policy = std::make_unique<StableConsensus>(options.window,
+                                                   options.max_iters);
+    }
+    if (options.rounds > 1) {
+        policy = std::make_unique<Restarts>(*policy, options.rounds);
+    }
+    return policy;
+}
+#endif
 
-    Serial<float> serial{data};
-    Result result{serial.find_motifs(motif_lengths[0], 0.1)};
+void print_result(const Result& result) {
     std::vector<int> ending_positions{result.positions};
 
     auto str{std::accumulate(std::next(begin(ending_positions)),
@@ -35,7 +265,311 @@ int main(int argc, char* argv[]) {
                                  return a + " " + std::to_string(b);
                              })};
     std::cout << "num correct: " << result.num_correct << "\n";
+    std::cout << "iterations: " << result.iterations
+              << (result.converged ? " (converged)" : "") << "\n";
+    if (result.pruned_fraction > 0) {
+        std::cout << "pruned: " << result.pruned_fraction
+                  << " of windows, error <= " << result.prune_error << "\n";
+    }
     std::cout << str << std::endl;
+    if (std::count(begin(result.reverse_strand), end(result.reverse_strand),
+                   true) > 0) {
+        std::string strands{};
+        for (bool reverse : result.reverse_strand) {
+            strands += reverse ? '-' : '+';
+        }
+        std::cout << "strands: " << strands << std::endl;
+    }
+}
+
+/* Prints result as a single-line JSON object */
+void print_json(const Result& result) {
+    write_json(std::cout, result);
+    std::cout << std::endl;
+}
+
+#ifndef MPI
+/* Runs the out-of-core sampler over a block store */
+int run_store(const Options& options) {
+    BlockStore store{options.store_path};
+    // --max-iters counts single-sequence updates, as for the other samplers
+    int max_sweeps{0};
+    if (options.given.contains("--max-iters")) {
+        int num_sequences{static_cast<int>(store.num_sequences())};
+        max_sweeps =
+            std::max(1, options.max_iters / std::max(1, num_sequences));
+    }
+    Streaming<float> sampler{store, options.budget_mb << 20, max_sweeps};
+    sampler.set_both_strands(options.both_strands);
+    sampler.set_pruning(options.prune);
+    // the calling thread scores one chunk itself
+    std::unique_ptr<ThreadPool> score_pool{};
+    if (options.score_threads > 1) {
+        score_pool = std::make_unique<ThreadPool>(options.score_threads - 1);
+        sampler.set_score_pool(score_pool.get());
+    }
+    std::cout << "seed: " << rng::seed() << "\n"
+              << "streaming " << store.num_sequences() << " sequences in "
+              << store.num_blocks() << " blocks\n";
+
+    Result result{sampler.find_motifs(options.k, 0.1)};
+    options.json ? print_json(result) : print_result(result);
+    return 0;
+}
+#endif
+}  // namespace
+
+int main(int argc, char* argv[]) {
+#ifdef MPI
+    MPI_Init(&argc, &argv);
+    int rank{};
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    bool is_root{rank == 0};
+#else
+    bool is_root{true};
+#endif
+
+    Options options{};
+    if (!parse(argc, argv, options)) {
+        print_usage(argv[0]);
+#ifdef MPI
+        MPI_Finalize();
+#endif
+        return 1;
+    }
+    if (std::string error{unsupported_option(options)}; !error.empty()) {
+        if (is_root) {
+            std::cerr << error << "\n";
+        }
+#ifdef MPI
+        MPI_Finalize();
+#endif
+        return 1;
+    }
+    int k{options.k};
+    int num_chains{options.num_chains};
+    unsigned num_threads{options.num_threads};
+    const auto& fasta_path{options.fasta_path};
+    // Data tells a dataset cache from FASTA by its header
+    const auto& input_path{fasta_path.empty() ? options.data_path
+                                              : fasta_path};
+    const auto& args{options.args};
+
+#ifndef MPI
+    try {
+        if (!options.store_path.empty()) {
+            return run_store(options);
+        }
+        if (!options.write_store_path.empty() && !fasta_path.empty()) {
+            BlockStore::write_fasta(fasta_path, options.write_store_path,
+                                    options.block_mb << 20);
+            return 0;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+#endif
+
+#ifdef MPI
+    // every rank must generate the same data and background
+    std::uint64_t seed{rng::seed()};
+    MPI_Bcast(&seed, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    rng::set_seed(seed);
+#endif
+
+    bool file_mode{!input_path.empty()};
+    // when serving, stdout carries nothing but results
+    std::ostream& log{options.serve ? std::cerr : std::cout};
+    DataHandle loaded{};
+    if (file_mode) {
+        auto start{std::chrono::steady_clock::now()};
+        try {
+            loaded = std::make_shared<const Data>(input_path, num_threads);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+#ifdef MPI
+            MPI_Finalize();
+#endif
+            return 1;
+        }
+        auto end{std::chrono::steady_clock::now()};
+
+        if (is_root) {
+            auto [num_sequences, longest] = loaded->size();
+            log << "seed: " << rng::seed() << "\n"
+                << "loaded " << num_sequences
+                << " sequences (longest " << longest << ") in "
+                << std::chrono::duration<double, std::milli>(end - start)
+                       .count()
+                << " ms\n";
+        }
+    } else if (!args.empty()) {
+        int num_m = std::stoi(args[0]);
+        int m_len = std::stoi(args[1]);
+        int num_s = std::stoi(args[2]);
+        int s_len = std::stoi(args[3]);
+        std::vector<int> motif_lengths(num_m, m_len);
+        int num_sequences{num_s};
+        int sequence_length{s_len};
+        k = motif_lengths[0];
+
+        try {
+            loaded = std::make_shared<const Data>(
+                motif_lengths, num_sequences, sequence_length,
+                rng::stream(rng::data_stream), options.mutation_rate,
+                num_threads);
+        } catch (const std::exception& e) {
+            if (is_root) {
+                std::cerr << e.what() << "\n";
+            }
+#ifdef MPI
+            MPI_Finalize();
+#endif
+            return 1;
+        }
+        if (is_root && options.write_store_path.empty() &&
+            options.write_data_path.empty()) {
+            log << "seed: " << rng::seed() << "\n";
+            log << *loaded << std::endl;
+        }
+    }
+
+#ifndef MPI
+    if (options.serve) {
+        JobServer server{loaded, k, num_threads};
+        try {
+            if (options.socket_path.empty()) {
+                server.serve(std::cin, std::cout);
+            } else {
+                server.listen(options.socket_path);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+#endif
+    const Data& data{*loaded};
+
+    if (!options.write_store_path.empty()) {
+        try {
+            BlockStore::write(data, options.write_store_path,
+                              options.block_mb << 20);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    if (!options.write_data_path.empty()) {
+        try {
+            data.save(options.write_data_path);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    // the samplers need at least one window in every sequence
+    auto lengths{data.lengths()};
+    if (lengths.empty() ||
+        k >= *std::min_element(begin(lengths), end(lengths))) {
+        if (is_root) {
+            std::cerr << (lengths.empty()
+                              ? "no sequences in " + input_path
+                              : "k must be shorter than every sequence")
+                      << "\n";
+        }
+#ifdef MPI
+        MPI_Finalize();
+#endif
+        return 1;
+    }
+
+    std::unique_ptr<GibbsSampler<float>> sampler{};
+#ifdef MPI
+    // Mpi counts whole sweeps, so convert the iteration-based options
+    int num_sequences{data.size().first};
+    int max_sweeps{std::max(1, options.max_iters / num_sequences)};
+    int stable_sweeps{
+        options.stop == "consensus"
+            ? std::max(1, options.window / num_sequences)
+            : 0};
+    sampler = std::make_unique<Mpi<float>>(data, num_chains, max_sweeps,
+                                           stable_sweeps);
+#else
+    auto policy{make_policy(options)};
+    Hogwild<float>* hogwild{};
+    if (options.hogwild_threads > 0) {
+        auto async{std::make_unique<Hogwild<float>>(
+            loaded, options.hogwild_threads)};
+        async->set_policy(*policy);
+        hogwild = async.get();
+        sampler = std::move(async);
+    } else if (num_chains > 1) {
+        sampler = std::make_unique<MultiStart<float>>(loaded, num_chains,
+                                                      num_threads, *policy);
+    } else {
+        auto serial{std::make_unique<Serial<float>>(loaded)};
+        serial->set_policy(*policy);
+        sampler = std::move(serial);
+    }
+#endif
+    sampler->set_pruning(options.prune);
+    sampler->set_both_strands(options.both_strands);
+    sampler->set_background_order(options.background_order);
+
+    // the calling thread scores one chunk itself
+    std::unique_ptr<ThreadPool> score_pool{};
+    if (options.score_threads > 1) {
+        score_pool = std::make_unique<ThreadPool>(options.score_threads - 1);
+        sampler->set_score_pool(score_pool.get());
+    }
+    if (options.num_motifs == 1) {
+        Result result{sampler->find_motifs(k, 0.1)};
+        if (is_root) {
+            options.json ? print_json(result) : print_result(result);
+        }
+#ifndef MPI
+        if (hogwild && !options.json) {
+            const auto& staleness{hogwild->staleness()};
+            std::cout << "staleness: " << staleness.mean << " mean, "
+                      << staleness.max << " max over " << staleness.updates
+                      << " updates\n";
+        }
+#endif
+    } else {
+        MultiMotif<float> driver{data, *sampler};
+        std::vector<Result> results{};
+        try {
+            results = driver.find_motifs(
+                std::vector<int>(options.num_motifs, k), 0.1);
+        } catch (const std::invalid_argument& e) {
+            if (is_root) {
+                std::cerr << e.what() << "\n";
+            }
+#ifdef MPI
+            sampler.reset();
+            MPI_Finalize();
+#endif
+            return 1;
+        }
+        for (std::size_t m{}; is_root && m < results.size(); ++m) {
+            if (options.json) {
+                print_json(results[m]);
+                continue;
+            }
+            std::cout << "motif " << m << ": " << results[m].consensus
+                      << " (embedded motif " << results[m].motif_id << ")\n";
+            print_result(results[m]);
+        }
+    }
 
+#ifdef MPI
+    sampler.reset();
+    MPI_Finalize();
+#endif
     return 0;
 }
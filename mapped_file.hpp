@@ -0,0 +1,59 @@
+#pragma once
+
+#include "cstddef"
+#include "stdexcept"
+#include "string"
+
+#include "fcntl.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#include "unistd.h"
+
+/* Read-only memory mapping of a whole file; unmapped on destruction */
+class MappedFile
+{
+    public:
+        /* Throws std::runtime_error if path cannot be opened or mapped */
+        explicit MappedFile(const std::string& path)
+        {
+            int fd { ::open(path.c_str(), O_RDONLY) };
+            if (fd < 0) {
+                throw std::runtime_error { "cannot open " + path };
+            }
+
+            struct stat info {};
+            if (::fstat(fd, &info) != 0) {
+                ::close(fd);
+                throw std::runtime_error { "cannot stat " + path };
+            }
+
+            m_size = info.st_size;
+            if (m_size > 0) {
+                void* addr { ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0) };
+                if (addr == MAP_FAILED) {
+                    ::close(fd);
+                    throw std::runtime_error { "cannot mmap " + path };
+                }
+                m_data = static_cast<const char*>(addr);
+                ::madvise(addr, m_size, MADV_SEQUENTIAL);
+            }
+            ::close(fd);
+        }
+
+        ~MappedFile()
+        {
+            if (m_data) {
+                ::munmap(const_cast<char*>(m_data), m_size);
+            }
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return m_data; }
+        std::size_t size() const { return m_size; }
+
+    private:
+        const char* m_data {};
+        std::size_t m_size {};
+};
@@ -0,0 +1,47 @@
+#include "algorithm"
+#include "utility"
+#include "vector"
+
+#include "mask.hpp"
+
+Mask::Mask(int num_sequences)
+    : m_claimed(num_sequences)
+{
+}
+
+void Mask::claim(int sequence, int start, int length)
+{
+    m_claimed[sequence].emplace_back(start, start + length);
+}
+
+bool Mask::masked(int sequence, int start, int width) const
+{
+    for (const auto& [begin, end] : m_claimed[sequence]) {
+        if (start < end && begin < start + width) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Mask::has_free_window(int sequence, int num_windows, int width) const
+{
+    // each claim blocks the window starts [begin - width + 1, end)
+    std::vector<std::pair<int, int>> blocked { m_claimed[sequence] };
+    std::sort(begin(blocked), end(blocked));
+    int free_start {};
+    for (const auto& [begin, end] : blocked) {
+        if (begin - width + 1 > free_start) {
+            break;
+        }
+        free_start = std::max(free_start, end);
+    }
+    return free_start < num_windows;
+}
+
+void Mask::clear()
+{
+    for (auto& claimed : m_claimed) {
+        claimed.clear();
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "utility"
+#include "vector"
+
+/* Regions of sequences already claimed by found motifs; a sampler never
+ * places a window over a claimed region
+ */
+class Mask
+{
+    public:
+        explicit Mask(int num_sequences);
+
+        /* Claims [start, start + length) of sequence */
+        void claim(int sequence, int start, int length);
+
+        /* True if the window [start, start + width) of sequence overlaps a 
+         * claimed region 
+         */
+        bool masked(int sequence, int start, int width) const;
+
+        /* True if some window [start, start + width) of sequence with start
+         * in [0, num_windows) overlaps no claimed region
+         */
+        bool has_free_window(int sequence, int num_windows, int width) const;
+
+        /* Claimed [begin, end) regions of sequence, in claim order */
+        const std::vector<std::pair<int, int>>& claimed(int sequence) const
+        {
+            return m_claimed[sequence];
+        }
+
+        /* Releases every claim */
+        void clear();
+
+    private:
+        std::vector<std::vector<std::pair<int, int>>> m_claimed;
+};
@@ -0,0 +1,245 @@
+#pragma once
+
+#ifdef MPI
+
+#include "algorithm"
+#include "limits"
+#include "string"
+#include "vector"
+
+#include "mpi.h"
+
+#include "gibbs_sampler.hpp"
+#include "rng.hpp"
+#include "utility.hpp"
+
+/* Distributed Gibbs sampler: sequences are partitioned across the ranks of a
+ * communicator and every rank resamples its own block once per sweep. PWM
+ * counts stay consistent through an allreduce of integer count deltas at the
+ * end of each sweep; within a sweep a rank sees the global counts from the
+ * previous sweep plus its own updates.
+ * Several chains may run side by side; each spans every rank and their
+ * deltas share one allreduce per sweep.
+ */
+template <typename T>
+class Mpi : public GibbsSampler<T> {
+    public: 
+        /* chains_per_rank : independent chains, each distributed over all
+         * ranks; the most likely one is returned
+         * max_sweeps : sweep limit; 0 matches Serial's 10'000 single-sequence
+         * updates
+         * stable_sweeps : a chain stops once its consensus is unchanged for
+         * this many sweeps; 0 disables the check
+         * gen : must be identical on every rank (e.g. a broadcast seed)
+         */
+        Mpi(const Data& data, int chains_per_rank = 1, int max_sweeps = 0,
+            int stable_sweeps = 0, MPI_Comm comm = MPI_COMM_WORLD,
+            rng::Philox gen = rng::stream(rng::sampler_stream));
+
+        Result find_motifs(int k, T pseudocount) override;
+
+        int rank() const { return m_rank; }
+
+    private:
+        struct Chain
+        {
+            /* Only entries of sequences owned by this rank are current 
+             * until the final gather 
+             */
+            std::vector<int> positions;
+
+            /* Global counts as of the last sweep plus this rank's updates
+             * in the current sweep 
+             */
+            Pwm<T> pwm;
+
+            /* Global integer counts as of the last sweep, 4*k entries */
+            std::vector<int> counts;
+
+            /* Count changes made by this rank since counts was taken */
+            std::vector<int> delta;
+
+            std::string consensus;
+            int stable_sweeps;
+            bool active;
+        };
+
+        const MPI_Comm m_comm;
+        const int m_rank;
+        const int m_size;
+        const int m_chainsPerRank;
+        const int m_maxSweeps;
+        const int m_stableSweeps;
+
+        /* Owned sequences are [m_begin, m_end) */
+        int m_begin;
+        int m_end;
+
+        static int comm_rank(MPI_Comm comm);
+        static int comm_size(MPI_Comm comm);
+
+        /* Sets chain.delta to the difference between its PWM and counts */
+        static void take_delta(Chain& chain);
+
+        /* Resamples every owned sequence of chain once */
+        void sweep(Chain& chain);
+};
+
+template <typename T>
+int Mpi<T>::comm_rank(MPI_Comm comm)
+{
+    int rank {};
+    MPI_Comm_rank(comm, &rank);
+    return rank;
+}
+
+template <typename T>
+int Mpi<T>::comm_size(MPI_Comm comm)
+{
+    int size {};
+    MPI_Comm_size(comm, &size);
+    return size;
+}
+
+template <typename T>
+Mpi<T>::Mpi(const Data& data, int chains_per_rank, int max_sweeps, 
+    int stable_sweeps, MPI_Comm comm, rng::Philox gen)
+    : GibbsSampler<T>(data, gen),
+      m_comm { comm },
+      m_rank { comm_rank(comm) },
+      m_size { comm_size(comm) },
+      m_chainsPerRank { chains_per_rank },
+      m_maxSweeps { max_sweeps },
+      m_stableSweeps { stable_sweeps }
+{
+    // every rank counts the same exact background and so scores 
+    // identically; position draws diverge per rank
+    this->m_gen = this->m_gen.split(m_rank);
+
+    int num_sequences { this->m_data.size().first };
+    m_begin = static_cast<long>(num_sequences) * m_rank / m_size;
+    m_end = static_cast<long>(num_sequences) * (m_rank + 1) / m_size;
+}
+
+template <typename T>
+void Mpi<T>::take_delta(Chain& chain)
+{
+    const auto& counts { chain.pwm.counts() };
+    for (int i {}; i < static_cast<int>(counts.size()); ++i) {
+        chain.delta[i] = counts[i] - chain.counts[i];
+    }
+}
+
+template <typename T>
+void Mpi<T>::sweep(Chain& chain)
+{
+    for (int s { m_begin }; s < m_end; ++s) {
+        int& position { chain.positions[s] };
+        this->update_counts(chain.pwm, s, position, false);
+        position = this->sample(this->score(chain.pwm, s));
+        this->update_counts(chain.pwm, s, position);
+    }
+    take_delta(chain);
+}
+
+template <typename T>
+Result Mpi<T>::find_motifs(int k, T pseudocount)
+{
+    int num_sequences { this->m_data.size().first };
+    int max_sweeps { m_maxSweeps > 0 ? m_maxSweeps : std::max(1, 10'000 / num_sequences) };
+
+    // random starting positions for owned sequences, then global counts
+    std::vector<Chain> chains {};
+    chains.reserve(m_chainsPerRank);
+    std::vector<int> buffer(m_chainsPerRank * 4*k);
+    for (int c {}; c < m_chainsPerRank; ++c) {
+        auto& chain { chains.emplace_back(Chain {
+            .positions = std::vector<int>(num_sequences),
+            .pwm = this->make_pwm(k, pseudocount),
+            .counts = std::vector<int>(4*k),
+            .delta = std::vector<int>(4*k),
+            .consensus = {},
+            .stable_sweeps = 0,
+            .active = true
+        }) };
+        for (int s { m_begin }; s < m_end; ++s) {
+            chain.positions[s] = this->random_position(s, k);
+            this->update_counts(chain.pwm, s, chain.positions[s]);
+        }
+        take_delta(chain);
+    }
+
+    int sweeps {};
+    auto active = [&chains]() {
+        return std::any_of(begin(chains), end(chains), [](const Chain& c) { return c.active; });
+    };
+    do {
+        // fold this sweep's deltas (or the initial counts) into every rank
+        for (int c {}; c < m_chainsPerRank; ++c) {
+            std::copy(begin(chains[c].delta), end(chains[c].delta), begin(buffer) + c*4*k);
+        }
+        MPI_Allreduce(MPI_IN_PLACE, buffer.data(), buffer.size(), MPI_INT, MPI_SUM, m_comm);
+        for (int c {}; c < m_chainsPerRank; ++c) {
+            auto& chain { chains[c] };
+            for (int i {}; i < 4*k; ++i) {
+                chain.counts[i] += buffer[c*4*k + i];
+            }
+            std::fill(begin(chain.delta), end(chain.delta), 0);
+            chain.pwm.assign(chain.counts, num_sequences);
+
+            // counts are identical on every rank, so this decision is too
+            std::string consensus { chain.pwm.consensus() };
+            chain.stable_sweeps = consensus == chain.consensus ? chain.stable_sweeps + 1 : 0;
+            chain.consensus = consensus;
+            if (m_stableSweeps > 0 && chain.stable_sweeps >= m_stableSweeps) {
+                chain.active = false;
+            }
+        }
+
+        if (sweeps++ == max_sweeps || !active()) {
+            break;
+        }
+        for (auto& chain : chains) {
+            if (chain.active) {
+                sweep(chain);
+            }
+        }
+    } while (true);
+
+    // share every rank's positions, then pick the most likely chain
+    std::vector<int> recv_counts(m_size);
+    std::vector<int> displs(m_size);
+    for (int r {}; r < m_size; ++r) {
+        displs[r] = static_cast<long>(num_sequences) * r / m_size;
+        recv_counts[r] = static_cast<long>(num_sequences) * (r + 1) / m_size - displs[r];
+    }
+
+    // every rank now holds identical counts and positions, so all pick the
+    // same chain
+    Result best {};
+    best.log_likelihood = -std::numeric_limits<double>::infinity();
+    for (auto& chain : chains) {
+        MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, chain.positions.data(),
+            recv_counts.data(), displs.data(), MPI_INT, m_comm);
+
+        double log_likelihood { 
+            static_cast<double>(this->log_likelihood(chain.pwm, chain.positions)) 
+        };
+        if (log_likelihood > best.log_likelihood) {
+            auto match { this->best_match(chain.positions, k) };
+            best = {
+                .num_correct = match.second,
+                .consensus = chain.consensus,
+                .motif_id = match.first,
+                .log_likelihood = log_likelihood,
+                .iterations = (sweeps - 1) * num_sequences,
+                .converged = !chain.active
+            };
+            this->set_positions(best, chain.positions, k);
+        }
+    }
+
+    return best;
+}
+
+#endif
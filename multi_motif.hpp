@@ -0,0 +1,81 @@
+#pragma once
+
+#include "algorithm"
+#include "numeric"
+#include "stdexcept"
+#include "string"
+#include "vector"
+
+#include "data.hpp"
+#include "gibbs_sampler.hpp"
+#include "mask.hpp"
+
+/* Finds several motifs in one dataset, one search after another with the
+ * same sampler, so the packed sequences and background model are shared
+ * by every search. The windows each found motif occupies are masked from
+ * the searches after it.
+ */
+template <typename T>
+class MultiMotif
+{
+    public:
+        /* sampler : must sample over data; not owned */
+        MultiMotif(const Data& data, GibbsSampler<T>& sampler);
+
+        /* Searches for one motif per entry of motif_lengths, longest first
+         * since longer motifs carry the stronger signal
+         * Returns one Result per entry, in the order of motif_lengths
+         * Throws std::invalid_argument if the motifs found so far claim every
+         * window of a sequence, leaving the next motif nowhere to go
+         */
+        std::vector<Result> find_motifs(const std::vector<int>& motif_lengths, 
+            T pseudocount);
+
+    private:
+        const Data& m_data;
+        GibbsSampler<T>& m_sampler;
+        Mask m_mask;
+};
+
+template <typename T>
+MultiMotif<T>::MultiMotif(const Data& data, GibbsSampler<T>& sampler)
+    : m_data { data },
+      m_sampler { sampler },
+      m_mask { data.size().first }
+{
+}
+
+template <typename T>
+std::vector<Result> MultiMotif<T>::find_motifs(
+    const std::vector<int>& motif_lengths, T pseudocount)
+{
+    std::vector<int> order(motif_lengths.size());
+    std::iota(begin(order), end(order), 0);
+    std::stable_sort(begin(order), end(order), [&motif_lengths](int a, int b) {
+        return motif_lengths[a] > motif_lengths[b];
+    });
+
+    m_mask.clear();
+    m_sampler.set_mask(&m_mask);
+
+    std::vector<Result> results(motif_lengths.size());
+    for (int m : order) {
+        int k { motif_lengths[m] };
+        for (int i {}; i < m_data.size().first; ++i) {
+            if (!m_mask.has_free_window(i, m_data.lengths()[i] - k, k)) {
+                m_sampler.set_mask(nullptr);
+                throw std::invalid_argument { 
+                    "no room for motif " + std::to_string(m) + " in sequence " + 
+                    std::to_string(i) + "; earlier motifs claim every window" 
+                };
+            }
+        }
+        results[m] = m_sampler.find_motifs(k, pseudocount);
+        for (int i {}; i < static_cast<int>(results[m].positions.size()); ++i) {
+            m_mask.claim(i, results[m].positions[i], k);
+        }
+    }
+
+    m_sampler.set_mask(nullptr);
+    return results;
+}
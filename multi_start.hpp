@@ -0,0 +1,104 @@
+#pragma once
+
+#include "algorithm"
+#include "future"
+#include "memory"
+#include "stdexcept"
+#include "stop_token"
+#include "vector"
+
+#include "convergence.hpp"
+#include "gibbs_sampler.hpp"
+#include "serial.hpp"
+#include "thread_pool.hpp"
+
+/* Runs several independent Serial chains from different random starting
+ * positions on a thread pool and keeps the most likely result
+ */
+template <typename T>
+class MultiStart : public GibbsSampler<T> {
+    public: 
+        /* num_chains : number of independent chains to run; throws 
+         * std::invalid_argument if below 1
+         * num_threads : pool size; 0 uses one thread per hardware thread
+         * policy : copied into every chain; a chain that converges under it
+         * cancels the remaining chains
+         */
+        MultiStart(const Data& data, int num_chains, unsigned num_threads = 0,
+            const StoppingPolicy& policy = StableConsensus {},
+            rng::Philox gen = rng::stream(rng::sampler_stream));
+
+        /* Chains borrow data from the handle held here */
+        MultiStart(DataHandle data, int num_chains, unsigned num_threads = 0,
+            const StoppingPolicy& policy = StableConsensus {},
+            rng::Philox gen = rng::stream(rng::sampler_stream));
+
+        Result find_motifs(int k, T pseudocount) override;
+
+    private:
+        const int m_numChains;
+        const std::unique_ptr<StoppingPolicy> m_policy;
+        ThreadPool m_pool;
+};
+
+template <typename T>
+MultiStart<T>::MultiStart(const Data& data, int num_chains, 
+    unsigned num_threads, const StoppingPolicy& policy, rng::Philox gen) 
+    : GibbsSampler<T>(data, gen),
+      m_numChains { num_chains },
+      m_policy { policy.clone() },
+      m_pool { num_threads }
+{
+    if (num_chains < 1) {
+        throw std::invalid_argument { "MultiStart needs at least one chain" };
+    }
+}
+
+template <typename T>
+MultiStart<T>::MultiStart(DataHandle data, int num_chains, 
+    unsigned num_threads, const StoppingPolicy& policy, rng::Philox gen) 
+    : GibbsSampler<T>(std::move(data), gen),
+      m_numChains { num_chains },
+      m_policy { policy.clone() },
+      m_pool { num_threads }
+{
+    if (num_chains < 1) {
+        throw std::invalid_argument { "MultiStart needs at least one chain" };
+    }
+}
+
+template <typename T>
+Result MultiStart<T>::find_motifs(int k, T pseudocount)
+{
+    std::stop_source stop {};
+
+    std::vector<std::future<Result>> chains {};
+    for (int i {}; i < m_numChains; ++i) {
+        chains.push_back(m_pool.submit([this, &stop, i, k, pseudocount]() {
+            Serial<T> chain { this->m_data, this->m_gen.split(i) };
+            chain.set_stop_token(stop.get_token());
+            chain.set_policy(*m_policy);
+            chain.set_mask(this->mask());
+            chain.set_score_pool(this->score_pool(), this->min_parallel_windows());
+            chain.set_pruning(this->prune_cutoff());
+            chain.set_both_strands(this->both_strands());
+            chain.set_background_order(this->background_order());
+
+            Result result { chain.find_motifs(k, pseudocount) };
+            if (result.converged) {
+                stop.request_stop();
+            }
+            return result;
+        }));
+    }
+
+    std::vector<Result> results {};
+    for (auto& chain : chains) {
+        results.push_back(chain.get());
+    }
+
+    return *std::max_element(begin(results), end(results), 
+        [](const Result& a, const Result& b) {
+            return a.log_likelihood < b.log_likelihood;
+        });
+}
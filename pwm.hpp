@@ -0,0 +1,218 @@
+#pragma once
+
+#include "algorithm"
+#include "array"
+#include "cassert"
+#include "cmath"
+#include "cstdint"
+#include "string"
+#include "vector"
+
+#include "data.hpp"
+#include "utility.hpp"
+
+/* Position weight matrix backed by integer nucleotide counts
+ * Probabilities are (count + pseudocount) / (total + 4*pseudocount), so
+ * arithmetic on the counts is exact no matter how many updates are made.
+ * The log-odds table is derived lazily, only for columns whose counts
+ * changed since it was last read, and every column carries a version stamp
+ * so callers can cheaply ask what changed since an earlier version().
+ */
+template <typename T>
+class Pwm
+{
+    public:
+        /* log_background : log of the background frequency of each base */
+        Pwm(int k, T pseudocount, const std::array<T, 4>& log_background);
+
+        int k() const { return m_k; }
+        T pseudocount() const { return m_pseudocount; }
+
+        /* Adds (increment) or removes the k-mer of seq starting at start_pos,
+         * or its reverse complement if reverse 
+         */
+        void update(const PackedSequence& seq, int start_pos, bool increment = true,
+            bool reverse = false);
+
+        /* Replaces every count; counts has 4*k entries laid out by column and
+         * total is the number of k-mers they describe 
+         */
+        void assign(const std::vector<int>& counts, int total);
+
+        const std::vector<int>& counts() const { return m_counts; }
+        int count(int column, int base) const { return m_counts[4*column + base]; }
+
+        /* Number of k-mers currently counted */
+        int total() const { return m_total; }
+
+        T probability(int column, int base) const;
+
+        /* Returns log(count + pseudocount) - log(background) for all 4*k 
+         * entries, recomputing only columns changed since the last call.
+         * The per-column normalizer log_normalizer() is left out: it is the
+         * same for every window, so it cancels when scores are normalized.
+         */
+        const std::vector<T>& log_odds();
+
+        /* log_odds() and the reverse complement PWM's log-odds interleaved
+         * as 8*k entries (see kernels::score_both_strands_scalar), 
+         * likewise recomputing only changed columns
+         */
+        const std::vector<T>& strand_log_odds();
+
+        /* log(total + 4*pseudocount) */
+        T log_normalizer() const;
+
+        /* Increases with every change to the counts */
+        std::uint64_t version() const { return m_version; }
+
+        /* True if column has changed after version was read */
+        bool changed_since(int column, std::uint64_t version) const
+        {
+            return m_columnVersions[column] > version;
+        }
+
+        /* Encoding of the most frequent base of column (lowest on ties) */
+        int argmax(int column) const;
+
+        /* Most frequent base of every column */
+        std::string consensus() const;
+
+    private:
+        const int m_k;
+        const T m_pseudocount;
+        const std::array<T, 4> m_logBackground;
+
+        std::vector<int> m_counts;
+        int m_total {};
+
+        std::uint64_t m_version {};
+        std::vector<std::uint64_t> m_columnVersions;
+
+        /* Lazily derived table and the version it reflects per column */
+        std::vector<T> m_logOdds;
+        std::vector<std::uint64_t> m_logOddsVersions;
+        std::vector<T> m_strandLogOdds;
+        std::vector<std::uint64_t> m_strandVersions;
+
+        /* log(c + pseudocount) for every count c seen so far */
+        std::vector<T> m_logCounts;
+
+        T log_count(int count);
+};
+
+template <typename T>
+Pwm<T>::Pwm(int k, T pseudocount, const std::array<T, 4>& log_background)
+    : m_k { k },
+      m_pseudocount { pseudocount },
+      m_logBackground { log_background },
+      m_counts(4*k),
+      m_version { 1 },
+      m_columnVersions(k, 1),
+      m_logOdds(4*k),
+      m_logOddsVersions(k, 0),
+      m_strandLogOdds(8*k),
+      m_strandVersions(k, 0)
+{
+}
+
+template <typename T>
+void Pwm<T>::update(const PackedSequence& seq, int start_pos, bool increment,
+    bool reverse)
+{
+    int delta { increment ? 1 : -1 };
+    ++m_version;
+    for (int i {}; i < m_k; ++i) {
+        int base { reverse ? utility::complement(seq[start_pos + m_k - 1 - i]) : seq[start_pos + i] };
+        m_counts[4*i + base] += delta;
+        m_columnVersions[i] = m_version;
+    }
+    m_total += delta;
+}
+
+template <typename T>
+void Pwm<T>::assign(const std::vector<int>& counts, int total)
+{
+    assert(counts.size() == m_counts.size());
+    ++m_version;
+    for (int i {}; i < m_k; ++i) {
+        if (!std::equal(begin(counts) + 4*i, begin(counts) + 4*(i+1), begin(m_counts) + 4*i)) {
+            m_columnVersions[i] = m_version;
+        }
+    }
+    m_counts = counts;
+    m_total = total;
+}
+
+template <typename T>
+T Pwm<T>::probability(int column, int base) const
+{
+    return (count(column, base) + m_pseudocount) / (m_total + 4*m_pseudocount);
+}
+
+template <typename T>
+T Pwm<T>::log_count(int count)
+{
+    while (static_cast<int>(m_logCounts.size()) <= count) {
+        m_logCounts.push_back(std::log(m_logCounts.size() + m_pseudocount));
+    }
+    return m_logCounts[count];
+}
+
+template <typename T>
+const std::vector<T>& Pwm<T>::log_odds()
+{
+    for (int i {}; i < m_k; ++i) {
+        if (m_logOddsVersions[i] == m_columnVersions[i]) {
+            continue;
+        }
+        for (int b {}; b < 4; ++b) {
+            m_logOdds[4*i + b] = log_count(m_counts[4*i + b]) - m_logBackground[b];
+        }
+        m_logOddsVersions[i] = m_columnVersions[i];
+    }
+    return m_logOdds;
+}
+
+template <typename T>
+const std::vector<T>& Pwm<T>::strand_log_odds()
+{
+    const auto& log_odds { this->log_odds() };
+    for (int i {}; i < m_k; ++i) {
+        if (m_strandVersions[i] == m_columnVersions[i]) {
+            continue;
+        }
+        // column i read backwards through complemented bases is column 
+        // k-1-i of the reverse complement PWM
+        int rc_column { m_k - 1 - i };
+        for (int b {}; b < 4; ++b) {
+            m_strandLogOdds[8*i + b] = log_odds[4*i + b];
+            m_strandLogOdds[8*rc_column + 4 + utility::complement(b)] = log_odds[4*i + b];
+        }
+        m_strandVersions[i] = m_columnVersions[i];
+    }
+    return m_strandLogOdds;
+}
+
+template <typename T>
+T Pwm<T>::log_normalizer() const
+{
+    return std::log(m_total + 4*m_pseudocount);
+}
+
+template <typename T>
+int Pwm<T>::argmax(int column) const
+{
+    auto first { begin(m_counts) + 4*column };
+    return std::distance(first, std::max_element(first, first + 4));
+}
+
+template <typename T>
+std::string Pwm<T>::consensus() const
+{
+    std::string result(m_k, ' ');
+    for (int i {}; i < m_k; ++i) {
+        result[i] = utility::decode(argmax(i));
+    }
+    return result;
+}
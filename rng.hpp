@@ -0,0 +1,135 @@
+#pragma once
+
+#include "array"
+#include "cstdint"
+#include "limits"
+#include "random"
+
+namespace rng {
+    /* Counter-based Philox4x32-10 generator
+     * Every (seed, stream) pair names an independent sequence, so streams can
+     * be handed to chains / threads without sharing or locking any state, and
+     * constructing one is just a few integer stores.
+     * Satisfies UniformRandomBitGenerator.
+     */
+    class Philox
+    {
+        public:
+            using result_type = std::uint32_t;
+
+            Philox(std::uint64_t seed, std::uint64_t stream = 0)
+                : m_key { static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32) },
+                  m_stream { stream },
+                  m_counter {},
+                  m_buffer {},
+                  m_index { 4 }
+            {
+            }
+
+            static constexpr result_type min() { return 0; }
+            static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+            result_type operator()()
+            {
+                if (m_index == 4) {
+                    m_buffer = block(m_counter++);
+                    m_index = 0;
+                }
+                return m_buffer[m_index++];
+            }
+
+            /* Returns an independent generator for sub-stream id of this stream */
+            Philox split(std::uint64_t id) const
+            {
+                Philox result { *this };
+                result.m_stream = mix(m_stream ^ mix(id + 1));
+                result.m_counter = 0;
+                result.m_index = 4;
+                return result;
+            }
+
+            /* Returns a double uniformly distributed in [0, 1) */
+            double canonical()
+            {
+                std::uint64_t hi { (*this)() };
+                std::uint64_t lo { (*this)() };
+                return (((hi << 32) | lo) >> 11) * 0x1.0p-53;
+            }
+
+            /* Returns an integer uniformly distributed in [0, n) */
+            std::uint32_t below(std::uint32_t n)
+            {
+                return static_cast<std::uint32_t>((static_cast<std::uint64_t>((*this)()) * n) >> 32);
+            }
+
+        private:
+            std::array<std::uint32_t, 2> m_key;
+            std::uint64_t m_stream;
+            std::uint64_t m_counter;
+            std::array<std::uint32_t, 4> m_buffer;
+            int m_index;
+
+            /* splitmix64 finalizer, used to derive stream ids */
+            static std::uint64_t mix(std::uint64_t x)
+            {
+                x += 0x9E3779B97F4A7C15;
+                x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+                x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+                return x ^ (x >> 31);
+            }
+
+            std::array<std::uint32_t, 4> block(std::uint64_t counter) const
+            {
+                std::array<std::uint32_t, 4> ctr {
+                    static_cast<std::uint32_t>(counter), static_cast<std::uint32_t>(counter >> 32),
+                    static_cast<std::uint32_t>(m_stream), static_cast<std::uint32_t>(m_stream >> 32)
+                };
+                std::array<std::uint32_t, 2> key { m_key };
+
+                for (int round {}; round < 10; ++round) {
+                    std::uint64_t p0 { static_cast<std::uint64_t>(0xD2511F53) * ctr[0] };
+                    std::uint64_t p1 { static_cast<std::uint64_t>(0xCD9E8D57) * ctr[2] };
+                    ctr = {
+                        static_cast<std::uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0],
+                        static_cast<std::uint32_t>(p1),
+                        static_cast<std::uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1],
+                        static_cast<std::uint32_t>(p0)
+                    };
+                    key[0] += 0x9E3779B9;
+                    key[1] += 0xBB67AE85;
+                }
+                return ctr;
+            }
+    };
+
+    /* Well-known stream ids of the process-wide seed */
+    enum Stream : std::uint64_t { data_stream = 1, sampler_stream = 2 };
+
+    namespace detail {
+        inline std::uint64_t& seed_storage()
+        {
+            static std::uint64_t seed { 
+                (static_cast<std::uint64_t>(std::random_device {}()) << 32) | std::random_device {}() 
+            };
+            return seed;
+        }
+    }
+
+    /* Returns the process-wide seed (random unless set_seed was called) */
+    inline std::uint64_t seed()
+    {
+        return detail::seed_storage();
+    }
+
+    /* Fixes the process-wide seed; call before creating any streams */
+    inline void set_seed(std::uint64_t seed)
+    {
+        detail::seed_storage() = seed;
+    }
+
+    /* Returns the generator for stream id under the process-wide seed */
+    inline Philox stream(std::uint64_t id)
+    {
+        return { seed(), id };
+    }
+}
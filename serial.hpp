@@ -4,10 +4,15 @@
 #include "array"
 #include "cassert"
 #include "cmath"
+#include "cstdint"
+#include "limits"
+#include "memory"
+#include "stop_token"
 #include "string"
 #include "unordered_map"
 #include "vector"
 
+#include "convergence.hpp"
 #include "gibbs_sampler.hpp"
 #include "utility.hpp"
 #include "data.hpp"
@@ -17,60 +22,128 @@
 template <typename T>
 class Serial : public GibbsSampler<T> {
     public: 
-        Serial(const Data& data);
+        Serial(const Data& data, 
+            rng::Philox gen = rng::stream(rng::sampler_stream));
+        Serial(DataHandle data, 
+            rng::Philox gen = rng::stream(rng::sampler_stream));
 
         Result find_motifs(int k, T pseudocount) override;
+
+        /* Ends find_motifs early once stop is requested */
+        void set_stop_token(std::stop_token stop);
+
+        /* Replaces the stopping policy (FixedIterations by default, the
+         * original 10'000 updates) with a copy of policy
+         */
+        void set_policy(const StoppingPolicy& policy);
+
+    private:
+        std::stop_token m_stop {};
+        std::unique_ptr<StoppingPolicy> m_policy;
 };
 
 template <typename T>
-Serial<T>::Serial(const Data& data) : GibbsSampler<T>(data) {}
+Serial<T>::Serial(const Data& data, rng::Philox gen) 
+    : GibbsSampler<T>(data, gen),
+      m_policy { std::make_unique<FixedIterations>() } 
+{
+}
+
+template <typename T>
+Serial<T>::Serial(DataHandle data, rng::Philox gen) 
+    : GibbsSampler<T>(std::move(data), gen),
+      m_policy { std::make_unique<FixedIterations>() } 
+{
+}
+
+template <typename T>
+void Serial<T>::set_stop_token(std::stop_token stop)
+{
+    m_stop = stop;
+}
+
+template <typename T>
+void Serial<T>::set_policy(const StoppingPolicy& policy)
+{
+    m_policy = policy.clone();
+}
 
 template <typename T>
 Result Serial<T>::find_motifs(int k, T pseudocount)
 {
     auto [num_sequences, sequence_length] { this->m_data.size() };
 
-    std::vector<int> positions { this->init_positions(k) }; 
-    std::vector<T> pwm { this->init_pwm(positions, k, pseudocount) };
-
-	std::vector<T> tmp_pwm {};
-
-    auto has_converged = [this, &pwm, &tmp_pwm, &k](const int max_iters = 10'000, const int stable_consensus = 200) {
-        static int iter_count {};
-		static int iters_since_change {};
-		
-		iters_since_change = this->consensus(pwm, k) == this->consensus(tmp_pwm, k) ?
-			iters_since_change + 1 :
-			0;
-		// std::cout << "iters_since_change: " << iters_since_change << "iter_count: " << iter_count << std::endl;
-	
-        return iter_count++ > max_iters; // || iters_since_change > stable_consensus;
-    };
-
-    // for (auto s : pwm) {
-    //     std::cout << s << " ";
-    // }
-    // std::cout << std::endl;
-
-    int withheld { 0 }; // TODO: should consider 1 iter 1 full iteration through all sequences
-    this->update_counts(pwm, withheld, positions[withheld], k, pseudocount, false); 
-
-    do {
-        std::vector<T> scores { this->score(pwm, k, withheld) };
-
-		positions[withheld] = this->sample(scores);
-
-        int new_withheld { (withheld + 1) % num_sequences }; 
-
-        tmp_pwm = this->update_pwm(pwm, positions, k, pseudocount, withheld, new_withheld);
-		withheld = new_withheld;
-		// std::cout << "num correct pos: " << num_correct(positions, k) << std::endl;
-    } while (!has_converged());
-
-    Result result {
-        .positions = positions,
-	    .num_correct = this->num_correct(positions, k),
-	    .consensus = this->consensus(pwm, k)
-    };
-    return result;
+    Result best {};
+    best.log_likelihood = -std::numeric_limits<double>::infinity();
+    int total_iters {};
+    Stats stats {};
+    std::uint64_t allocations { instrument::allocations() };
+    this->reset_prune_report();
+
+    for (int round {}; round < m_policy->rounds() && !m_stop.stop_requested(); ++round) {
+        std::vector<int> positions { this->init_positions(k) }; 
+        Pwm<T> pwm { this->init_pwm(positions, k, pseudocount) };
+        ConsensusTracker<T> tracker { pwm };
+        m_policy->reset();
+
+        Progress progress {
+            .num_sequences = num_sequences,
+            .log_likelihood = [&, this]() {
+                return static_cast<double>(this->log_likelihood(pwm, positions));
+            }
+        };
+        auto has_converged = [&, this]() {
+            bool changed { tracker.update(pwm) };
+            progress.stable_iterations = changed ? 0 : progress.stable_iterations + 1;
+            ++progress.iteration;
+            if constexpr (instrument::enabled) {
+                if (changed) {
+                    stats.last_change = total_iters + progress.iteration;
+                }
+            }
+            return m_policy->stop(progress) || m_stop.stop_requested();
+        };
+
+        int withheld { 0 }; // TODO: should consider 1 iter 1 full iteration through all sequences
+        this->update_counts(pwm, withheld, positions[withheld], false); 
+
+        do {
+            const auto& scores { instrument::timed(stats.score_ns, [&]() -> const auto& {
+                return this->score(pwm, withheld);
+            }) };
+
+            positions[withheld] = instrument::timed(stats.sample_ns, [&]() {
+                return this->sample(scores);
+            });
+
+            int new_withheld { (withheld + 1) % num_sequences }; 
+
+            instrument::timed(stats.update_ns, [&]() {
+                this->update_pwm(pwm, positions, withheld, new_withheld);
+            });
+            withheld = new_withheld;
+        } while (!instrument::timed(stats.convergence_ns, has_converged));
+
+        total_iters += progress.iteration;
+        double log_likelihood { progress.log_likelihood() };
+        if (log_likelihood > best.log_likelihood) {
+            auto [motif_id, num_correct] { this->best_match(positions, k) };
+            best = {
+                .num_correct = num_correct,
+                .consensus = tracker.consensus(),
+                .motif_id = motif_id,
+                .log_likelihood = log_likelihood,
+                .converged = m_policy->converged()
+            };
+            this->set_positions(best, positions, k);
+        }
+    }
+
+    best.iterations = total_iters;
+    const auto& report { this->prune_report() };
+    best.pruned_fraction = report.windows ? static_cast<double>(report.pruned) / report.windows : 0;
+    best.prune_error = report.max_error;
+    stats.allocations = instrument::allocations() - allocations;
+    best.stats = stats;
+    return best;
 }
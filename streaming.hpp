@@ -0,0 +1,257 @@
+#pragma once
+
+#include "algorithm"
+#include "array"
+#include "cstddef"
+#include "future"
+#include "stdexcept"
+#include "unordered_map"
+#include "vector"
+
+#include "block_store.hpp"
+#include "gibbs_sampler.hpp"
+
+/* Out-of-core sampler over a BlockStore: sequences are paged in one block 
+ * at a time and withheld in block order so reads stay sequential, while the
+ * next block is read in the background. Only the PWM, one position per 
+ * sequence, two blocks and the scoring buffers of one sequence are ever
+ * resident.
+ */
+template <typename T>
+class Streaming : public GibbsSampler<T> {
+    public: 
+        /* store : not owned; must outlive the sampler
+         * memory_budget : bytes available for everything resident_bytes()
+         * counts; throws std::invalid_argument if the store's blocks or 
+         * sequences are too large
+         * max_sweeps : passes over the store; 0 matches Serial's 10'000 
+         * single-sequence updates
+         */
+        Streaming(const BlockStore& store, std::size_t memory_budget, 
+            int max_sweeps = 0,
+            rng::Philox gen = rng::stream(rng::sampler_stream));
+
+        /* Throws std::invalid_argument if the footprint with the current 
+         * settings exceeds the memory budget
+         */
+        Result find_motifs(int k, T pseudocount) override;
+
+        /* Masks and Markov backgrounds need every sequence in memory; throw
+         * std::invalid_argument for anything but nullptr and order 0
+         */
+        void set_mask(const Mask* mask) override;
+        void set_background_order(int order) override;
+
+        /* Bytes resident during find_motifs(k, ...): two blocks, the 
+         * per-sequence sites and results, the PWM, and the scoring, 
+         * sampling, per-chunk and pruning buffers for the longest sequence
+         */
+        std::size_t resident_bytes(int k = 1) const;
+
+    private:
+        const BlockStore& m_store;
+        const std::size_t m_memoryBudget;
+        const int m_maxSweeps;
+
+        /* Throws std::invalid_argument if resident_bytes(k) is over budget */
+        void check_budget(int k = 1) const;
+
+        /* Stand-in for the base class' Data; every sequence is in m_store */
+        static const Data& no_data();
+
+        /* Exact base frequencies of every sequence in store */
+        static std::array<T, 4> count_background(const BlockStore& store);
+
+        /* Calls visit(block) for every block in order, reading the next block
+         * while the current one is visited 
+         */
+        template <typename F>
+        static void for_each_block(const BlockStore& store, F&& visit);
+};
+
+template <typename T>
+Streaming<T>::Streaming(const BlockStore& store, std::size_t memory_budget,
+    int max_sweeps, rng::Philox gen)
+    : GibbsSampler<T>(no_data(), count_background(store), gen),
+      m_store { store },
+      m_memoryBudget { memory_budget },
+      m_maxSweeps { max_sweeps }
+{
+    check_budget();
+}
+
+template <typename T>
+void Streaming<T>::set_mask(const Mask* mask)
+{
+    if (mask) {
+        throw std::invalid_argument { "streaming samplers do not support masks" };
+    }
+    GibbsSampler<T>::set_mask(mask);
+}
+
+template <typename T>
+void Streaming<T>::set_background_order(int order)
+{
+    if (order != 0) {
+        throw std::invalid_argument { "streaming samplers only support a base frequency background" };
+    }
+    GibbsSampler<T>::set_background_order(order);
+}
+
+template <typename T>
+std::size_t Streaming<T>::resident_bytes(int k) const
+{
+    std::size_t num_sequences { m_store.num_sequences() };
+    std::size_t max_length { static_cast<std::size_t>(m_store.max_length()) };
+    std::size_t columns { static_cast<std::size_t>(k) };
+    int strands { this->both_strands() ? 2 : 1 };
+    std::size_t chunks { this->score_pool() ? this->score_pool()->size() + 1 : 1 };
+    std::size_t bytes { 2 * m_store.max_block_bytes() +
+        // sites, then the result's positions and strands
+        sizeof(int) * num_sequences * 2 + (num_sequences + 7) / 8 +
+        // counts, both log-odds tables and their versions, and the log of 
+        // every count up to num_sequences (with room for vector growth)
+        columns * (4 * sizeof(int) + 12 * sizeof(T) + 3 * sizeof(std::uint64_t)) +
+        2 * sizeof(T) * (num_sequences + 1) +
+        // unpacked bases, then window scores and sample()'s prefix sums
+        max_length + 2 * sizeof(T) * strands * max_length +
+        // per-chunk futures, maxima, sums and pruned counts
+        chunks * (sizeof(std::future<void>) + 2 * sizeof(T) + sizeof(int)) };
+    if (this->prune_cutoff() > 0) {
+        // suffix bounds per strand and the reverse complement log-odds
+        bytes += sizeof(T) * (strands * (columns + 1) + 4 * columns);
+    }
+    return bytes;
+}
+
+template <typename T>
+void Streaming<T>::check_budget(int k) const
+{
+    std::size_t resident { resident_bytes(k) };
+    if (resident > m_memoryBudget) {
+        throw std::invalid_argument { 
+            "memory budget of " + std::to_string(m_memoryBudget) + " bytes is below the " +
+            std::to_string(resident) + " bytes needed; use smaller blocks" 
+        };
+    }
+}
+
+template <typename T>
+const Data& Streaming<T>::no_data()
+{
+    static const Data data { std::vector<int> {}, 0, 0 };
+    return data;
+}
+
+template <typename T>
+template <typename F>
+void Streaming<T>::for_each_block(const BlockStore& store, F&& visit)
+{
+    if (store.num_blocks() == 0) {
+        return;
+    }
+
+    auto read = [&store](std::size_t b) {
+        return std::async(std::launch::async, [&store, b]() { return store.read_block(b); });
+    };
+    std::future<Block> next { read(0) };
+    for (std::size_t b {}; b < store.num_blocks(); ++b) {
+        Block block { next.get() };
+        if (b + 1 < store.num_blocks()) {
+            next = read(b + 1);
+        }
+        visit(block);
+    }
+}
+
+template <typename T>
+std::array<T, 4> Streaming<T>::count_background(const BlockStore& store)
+{
+    std::array<std::uint64_t, 4> counts {};
+    for_each_block(store, [&counts](const Block& block) {
+        for (std::size_t i {}; i < block.num_sequences(); ++i) {
+            const auto seq { block.sequence(i) };
+            Background::count_bases(seq.words(), seq.size(), counts);
+        }
+    });
+
+    std::size_t total { counts[0] + counts[1] + counts[2] + counts[3] };
+    std::array<T, 4> result {};
+    for (int i {}; i < 4; ++i) {
+        result[i] = static_cast<T>(counts[i]) / std::max<std::size_t>(total, 1);
+    }
+    return result;
+}
+
+template <typename T>
+Result Streaming<T>::find_motifs(int k, T pseudocount)
+{
+    // k and settings such as both strands may have grown the footprint
+    check_budget(k);
+
+    int num_sequences { static_cast<int>(m_store.num_sequences()) };
+    int max_sweeps { m_maxSweeps > 0 ? m_maxSweeps : std::max(1, 10'000 / std::max(1, num_sequences)) };
+
+    std::vector<int> sites(num_sequences);
+    Pwm<T> pwm { this->make_pwm(k, pseudocount) };
+
+    for_each_block(m_store, [&](const Block& block) {
+        for (std::size_t i {}; i < block.num_sequences(); ++i) {
+            const auto seq { block.sequence(i) };
+            int& site { sites[block.first_sequence() + i] };
+            site = this->random_site(seq.size(), k);
+            this->update_site(pwm, seq, site);
+        }
+    });
+
+    for (int sweep {}; sweep < max_sweeps; ++sweep) {
+        for_each_block(m_store, [&](const Block& block) {
+            for (std::size_t i {}; i < block.num_sequences(); ++i) {
+                const auto seq { block.sequence(i) };
+                int& site { sites[block.first_sequence() + i] };
+                this->update_site(pwm, seq, site, false);
+                site = this->sample(this->score(pwm, seq));
+                this->update_site(pwm, seq, site);
+            }
+        });
+    }
+
+    // ground truth, likelihood and strands need the sequences, so take one
+    // more pass
+    std::vector<int> positions(num_sequences);
+    std::vector<bool> reverse_strand(num_sequences);
+    std::unordered_map<int, int> correct {};
+    const auto& log_odds { pwm.log_odds() };
+    T log_likelihood { -num_sequences * k * pwm.log_normalizer() };
+    for_each_block(m_store, [&](const Block& block) {
+        for (std::size_t i {}; i < block.num_sequences(); ++i) {
+            const auto seq { block.sequence(i) };
+            int index { static_cast<int>(block.first_sequence() + i) };
+            auto [position, reverse] { this->decode_site(seq.size(), k, sites[index]) };
+            positions[index] = position;
+            reverse_strand[index] = reverse;
+            log_likelihood += this->site_score(log_odds, seq, k, sites[index]);
+            for (const auto& motif : block.motifs(i)) {
+                if (std::abs(position - motif.start) < k) {
+                    ++correct[motif.id];
+                }
+            }
+        }
+    });
+
+    auto best = std::max_element(begin(correct), end(correct), 
+        [](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+            return a.second < b.second;
+        });
+
+    Result result {
+        .positions = positions,
+        .reverse_strand = reverse_strand,
+        .num_correct = correct.empty() ? 0 : best->second,
+        .consensus = pwm.consensus(),
+        .motif_id = correct.empty() ? -1 : best->first,
+        .log_likelihood = static_cast<double>(log_likelihood),
+        .iterations = max_sweeps * num_sequences
+    };
+    return result;
+}
@@ -0,0 +1,159 @@
+#include "algorithm"
+#include "atomic"
+#include "chrono"
+#include "exception"
+#include "mutex"
+#include "numeric"
+#include "thread"
+
+#include "data.hpp"
+#include "hogwild.hpp"
+#include "serial.hpp"
+#include "sweep.hpp"
+
+double SweepCell::cost() const
+{
+    return static_cast<double>(num_sequences) *
+        (sequence_length + num_motifs * motif_length) * motif_length;
+}
+
+std::vector<SweepCell> sweep_grid(const std::vector<int>& num_motifs,
+    const std::vector<int>& motif_lengths, const std::vector<int>& num_sequences,
+    const std::vector<int>& sequence_lengths)
+{
+    std::vector<SweepCell> result {};
+    for (int a : num_motifs) {
+        for (int b : motif_lengths) {
+            for (int c : num_sequences) {
+                for (int d : sequence_lengths) {
+                    result.push_back({ a, b, c, d });
+                }
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<SweepCell> default_sweep()
+{
+    std::vector<SweepCell> result {};
+    for (int a : { 1, 2, 4, 8 }) {
+        result.push_back({ a, 16, 16, 512 - 16 * a });
+    }
+    for (int b : { 8, 12, 16, 20 }) {
+        result.push_back({ 2, b, 16, 512 - 2 * b });
+    }
+    for (int c : { 16, 24, 32, 40 }) {
+        result.push_back({ 2, 16, c, 512 - 32 });
+    }
+    for (int d : { 256, 512, 1024, 2048 }) {
+        result.push_back({ 2, 16, 16, d - 32 });
+    }
+    return result;
+}
+
+std::vector<int> sweep_schedule(const std::vector<SweepCell>& cells, int reps)
+{
+    std::vector<int> result(cells.size() * reps);
+    std::iota(begin(result), end(result), 0);
+    std::stable_sort(begin(result), end(result), [&cells, reps](int a, int b) {
+        return cells[a / reps].cost() > cells[b / reps].cost();
+    });
+    return result;
+}
+
+std::vector<SweepRun> run_sweep(const std::vector<SweepCell>& cells, int reps,
+    const StoppingPolicy& policy, std::uint64_t seed, unsigned num_threads,
+    const std::function<void(const SweepRun&)>& on_done, unsigned sampler_threads)
+{
+    std::vector<int> order { sweep_schedule(cells, reps) };
+    std::vector<SweepRun> result(order.size());
+
+    auto run = [&](int i) {
+        using clock = std::chrono::steady_clock;
+        const SweepCell& cell { cells[i / reps] };
+
+        auto start { clock::now() };
+        Data data {
+            std::vector<int>(cell.num_motifs, cell.motif_length),
+            cell.num_sequences, cell.sequence_length,
+            rng::Philox { seed, rng::data_stream }.split(i), 0, 1
+        };
+        auto generated { clock::now() };
+
+        rng::Philox gen { rng::Philox { seed, rng::sampler_stream }.split(i) };
+        Result found {};
+        double staleness {};
+        if (sampler_threads > 1) {
+            Hogwild<float> sampler { data, sampler_threads, gen };
+            sampler.set_policy(policy);
+            found = sampler.find_motifs(cell.motif_length, 0.1);
+            staleness = sampler.staleness().mean;
+        } else {
+            Serial<float> sampler { data, gen };
+            sampler.set_policy(policy);
+            found = sampler.find_motifs(cell.motif_length, 0.1);
+        }
+        auto end { clock::now() };
+
+        using ms = std::chrono::duration<double, std::milli>;
+        result[i] = {
+            cell, i % reps, ms(generated - start).count(), ms(end - generated).count(),
+            found.iterations, found.converged, found.num_correct,
+            std::max(1u, sampler_threads), staleness
+        };
+    };
+
+    // runs are claimed in schedule order, so a thread that finishes early
+    // takes the next largest run left rather than waiting on its own queue
+    std::atomic<std::size_t> next {};
+    std::mutex done_mutex {};
+    std::exception_ptr error {};
+    auto work = [&]() {
+        for (std::size_t n { next++ }; n < order.size(); n = next++) {
+            try {
+                run(order[n]);
+                if (on_done) {
+                    std::lock_guard lock { done_mutex };
+                    on_done(result[order[n]]);
+                }
+            } catch (...) {
+                // the first failure ends the sweep once running cells finish
+                std::lock_guard lock { done_mutex };
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = order.size();
+            }
+        }
+    };
+
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    num_threads = std::min<std::size_t>(num_threads, order.size());
+    std::vector<std::jthread> workers {};
+    for (unsigned t { 1 }; t < num_threads; ++t) {
+        workers.emplace_back(work);
+    }
+    work();
+    workers.clear();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return result;
+}
+
+void write_sweep_csv(std::ostream& os, const std::vector<SweepRun>& runs)
+{
+    os << "num_motifs,motif_length,num_sequences,sequence_length,rep,"
+          "data_ms,wall_ms,iterations,converged,num_correct,sampler_threads,mean_staleness\n";
+    for (const auto& run : runs) {
+        const auto& cell { run.cell };
+        os << cell.num_motifs << "," << cell.motif_length << "," << cell.num_sequences << ","
+           << cell.sequence_length << "," << run.rep << "," << run.data_ms << ","
+           << run.wall_ms << "," << run.iterations << "," << (run.converged ? 1 : 0) << ","
+           << run.num_correct << "," << run.sampler_threads << "," << run.mean_staleness << "\n";
+    }
+}
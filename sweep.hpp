@@ -0,0 +1,81 @@
+#pragma once
+
+#include "cstdint"
+#include "functional"
+#include "iostream"
+#include "vector"
+
+#include "convergence.hpp"
+#include "rng.hpp"
+
+/* One point of a parameter sweep, in the terms of ./serial's arguments */
+struct SweepCell
+{
+    int num_motifs;
+    int motif_length;
+    int num_sequences;
+    int sequence_length;
+
+    /* Relative cost of a run, for scheduling: the work of one sweep over
+     * every sequence, since chains need roughly a constant number of them
+     */
+    double cost() const;
+};
+
+/* Outcome of one repetition of a cell */
+struct SweepRun
+{
+    SweepCell cell;
+    int rep;
+
+    /* Time to generate the dataset and to find the motif */
+    double data_ms;
+    double wall_ms;
+
+    int iterations;
+    bool converged;
+    int num_correct;
+
+    /* Threads resampling the chain, and their mean staleness (see 
+     * Hogwild::staleness); 1 and 0 for a Serial chain
+     */
+    unsigned sampler_threads;
+    double mean_staleness;
+};
+
+/* Every combination of the given values */
+std::vector<SweepCell> sweep_grid(const std::vector<int>& num_motifs,
+    const std::vector<int>& motif_lengths, const std::vector<int>& num_sequences,
+    const std::vector<int>& sequence_lengths);
+
+/* Each parameter varied on its own around 2 motifs of length 16 in 16 
+ * sequences of 512 bases, less the motifs
+ */
+std::vector<SweepCell> default_sweep();
+
+/* Returns run indices (cell * reps + rep) in the order they are started:
+ * costliest cells first, so the long runs do not end up last and leave
+ * the other threads idle
+ */
+std::vector<int> sweep_schedule(const std::vector<SweepCell>& cells, int reps);
+
+/* Runs reps repetitions of every cell concurrently, each a single chain 
+ * under policy, and returns them by cell then rep
+ * seed : run i generates its data from seed's data stream and samples 
+ * from its sampler stream, both split by i, so results do not depend on
+ * num_threads or scheduling
+ * num_threads : 0 uses one thread per hardware thread
+ * on_done : called (serialized) as each run finishes
+ * sampler_threads : above 1 runs each chain as a Hogwild on that many 
+ * threads instead of a Serial one; a sweep with and one without it, from
+ * the same seed, compare them on the same datasets
+ * Rethrows the first exception of any run, e.g. std::invalid_argument 
+ * for motifs that do not fit their sequences.
+ */
+std::vector<SweepRun> run_sweep(const std::vector<SweepCell>& cells, int reps,
+    const StoppingPolicy& policy, std::uint64_t seed, unsigned num_threads = 0,
+    const std::function<void(const SweepRun&)>& on_done = {},
+    unsigned sampler_threads = 1);
+
+/* Writes one row per run */
+void write_sweep_csv(std::ostream& os, const std::vector<SweepRun>& runs);
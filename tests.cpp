@@ -1,3 +1,844 @@
+#include "algorithm"
+#include "cassert"
+#include "cmath"
+#include "cstdint"
+#include "cstddef"
+#include "cstdio"
+#include "cstring"
+#include "filesystem"
+#include "fstream"
+#include "sstream"
+#include "iostream"
+#include "limits"
+#include "memory"
+#include "numeric"
+#include "random"
+#include "stdexcept"
+#include "string"
+#include "vector"
+
+#include "block_store.hpp"
+#include "convergence.hpp"
+#include "data.hpp"
+#include "data_cache.hpp"
+#include "hogwild.hpp"
+#include "job_server.hpp"
+#include "kernels.hpp"
+#include "mask.hpp"
+#include "multi_motif.hpp"
+#include "multi_start.hpp"
+#include "pwm.hpp"
+#include "serial.hpp"
+#include "streaming.hpp"
+#include "sweep.hpp"
+#include "thread_pool.hpp"
+#include "utility.hpp"
+
+namespace {
+    /* Compares every dispatchable kernel against the scalar loop */
+    template <typename T>
+    void test_score_windows()
+    {
+        std::mt19937 num_gen { 42 };
+        std::uniform_real_distribution<T> log_odds_distr(-4, 2);
+        std::uniform_int_distribution<int> base_distr(0, 3);
+
+        for (int k : { 1, 5, 6, 8, 16, 21, 32, 40 }) {
+            for (int sequence_length : { k, k + 3, k + 17, 1'000 }) {
+                std::vector<T> log_odds(4*k);
+                std::vector<std::uint8_t> bases(sequence_length);
+                for (auto& x : log_odds) x = log_odds_distr(num_gen);
+                for (auto& b : bases) b = base_distr(num_gen);
+
+                int num_windows { sequence_length - k };
+                std::vector<T> expected(num_windows);
+                kernels::score_windows_scalar(log_odds.data(), bases.data(), 
+                    num_windows, k, expected.data());
+
+                for (auto isa : { kernels::Isa::scalar, kernels::Isa::avx2, kernels::Isa::avx512 }) {
+                    if (!kernels::supports(isa)) continue;
+
+                    std::vector<T> actual(num_windows);
+                    kernels::score_windows(log_odds.data(), bases.data(), 
+                        num_windows, k, actual.data(), isa);
+                    for (int i {}; i < num_windows; ++i) {
+                        assert(std::abs(actual[i] - expected[i]) <= 1e-5 * (1 + std::abs(expected[i])));
+                    }
+                }
+            }
+        }
+    }
+
+    /* The fused kernels match scoring the reverse complemented PWM in a 
+     * separate pass, and a reverse strand PWM update counts the reverse 
+     * complement of the window
+     */
+    template <typename T>
+    void test_both_strands()
+    {
+        std::mt19937 num_gen { 7 };
+        std::uniform_int_distribution<int> base_distr(0, 3);
+
+        for (int k : { 3, 8, 21, 40 }) {
+            std::vector<std::uint8_t> bases(500);
+            for (auto& b : bases) b = base_distr(num_gen);
+            std::vector<std::uint64_t> words((bases.size() + 31) / 32);
+            for (std::size_t i {}; i < bases.size(); ++i) {
+                words[i >> 5] |= std::uint64_t { bases[i] } << (2 * (i & 31));
+            }
+            PackedSequence seq { words.data(), static_cast<int>(bases.size()) };
+
+            Pwm<T> pwm { k, 0.5, { -1.2, -1.5, -1.3, -1.6 } };
+            for (int start : { 3, 40, 41, 200 }) {
+                pwm.update(seq, start);
+            }
+            pwm.update(seq, 100, true, true);
+            for (int j {}; j < k; ++j) {
+                assert(pwm.count(j, utility::complement(bases[100 + k - 1 - j])) >= 1);
+            }
+
+            const auto& log_odds { pwm.log_odds() };
+            std::vector<T> rc_log_odds(4*k);
+            for (int j {}; j < k; ++j) {
+                for (int b {}; b < 4; ++b) {
+                    rc_log_odds[4*(k - 1 - j) + utility::complement(b)] = log_odds[4*j + b];
+                }
+            }
+
+            int num_windows { static_cast<int>(bases.size()) - k };
+            std::vector<T> expected(num_windows);
+            std::vector<T> expected_rc(num_windows);
+            kernels::score_windows_scalar(log_odds.data(), bases.data(), 
+                num_windows, k, expected.data());
+            kernels::score_windows_scalar(rc_log_odds.data(), bases.data(), 
+                num_windows, k, expected_rc.data());
+
+            for (auto isa : { kernels::Isa::scalar, kernels::Isa::avx2, kernels::Isa::avx512 }) {
+                if (!kernels::supports(isa)) continue;
+
+                std::vector<T> actual(num_windows);
+                std::vector<T> actual_rc(num_windows);
+                kernels::both_strands_kernel<T>(k, isa)(pwm.strand_log_odds().data(), 
+                    bases.data(), num_windows, k, actual.data(), actual_rc.data());
+                for (int i {}; i < num_windows; ++i) {
+                    assert(std::abs(actual[i] - expected[i]) <= 1e-4 * (1 + std::abs(expected[i])));
+                    assert(std::abs(actual_rc[i] - expected_rc[i]) <= 1e-4 * (1 + std::abs(expected_rc[i])));
+                }
+            }
+        }
+    }
+
+    /* A saved dataset maps back in with identical sequences and ground
+     * truth, and a file that is not a cache is still read as FASTA
+     */
+    void test_data_cache()
+    {
+        auto path { std::filesystem::temp_directory_path() / "motif_cache_test.bin" };
+        Data data { { 8, 5 }, 30, 77, rng::Philox { 25 }, 0.2 };
+        data.save(path);
+
+        Data mapped { path.string() };
+        assert(mapped.size() == data.size());
+        assert(mapped.words().size() == data.words().size());
+        assert(std::equal(begin(mapped.words()), end(mapped.words()), begin(data.words())));
+        for (int i {}; i < 30; ++i) {
+            assert(mapped.packed(i).size() == 77);
+            auto expected { data.motifs(i) };
+            auto actual { mapped.motifs(i) };
+            assert(actual.size() == expected.size());
+            for (std::size_t m {}; m < actual.size(); ++m) {
+                assert(actual[m].m_motif == expected[m].m_motif);
+                assert(actual[m].m_baseMotif == expected[m].m_baseMotif);
+                assert(actual[m].m_startingIndex == expected[m].m_startingIndex);
+                assert(actual[m].m_motifId == expected[m].m_motifId);
+            }
+        }
+
+        Serial<double> sampler { mapped, rng::Philox { 26 } };
+        sampler.set_policy(FixedIterations { 100 });
+        assert(sampler.find_motifs(8, 0.1).positions.size() == 30);
+
+        // a sequence reaching past the words, or of negative length, is
+        // rejected before anything reads it
+        std::string bytes {};
+        {
+            std::ifstream in { path, std::ios::binary };
+            bytes.assign(std::istreambuf_iterator<char> { in }, {});
+        }
+        cache_format::FileHeader header {};
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        auto corrupt = [&](std::size_t at, auto value) {
+            std::string copy { bytes };
+            std::memcpy(copy.data() + at, &value, sizeof(value));
+            std::ofstream { path, std::ios::binary } << copy;
+            try {
+                Data { path.string() };
+            } catch (const std::runtime_error&) {
+                return true;
+            }
+            return false;
+        };
+        assert(corrupt(header.offsets_offset + 8 * 29, header.num_words - 1));
+        assert(corrupt(header.offsets_offset, ~std::uint64_t {}));
+        assert(corrupt(header.lengths_offset, std::int32_t { -1 }));
+        assert(corrupt(offsetof(cache_format::FileHeader, num_words), (std::uint64_t { 1 } << 61) + 1));
+        std::filesystem::remove(path);
+    }
+
+    /* Generated datasets do not depend on the thread count, embed every 
+     * (mutated) motif where recorded without overlap, and mutate at about
+     * the requested rate
+     */
+    void test_generate_data()
+    {
+        rng::Philox gen { 21 };
+        std::vector<int> indices { utility::rand_indices(gen, 100, 10, 10) };
+        std::sort(begin(indices), end(indices));
+        for (int i {}; i < 10; ++i) {
+            assert(indices[i] == 10 * i);
+        }
+        bool threw {};
+        try {
+            utility::rand_indices(gen, 100, 10, 11);
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        assert(threw);
+
+        std::vector<int> lengths { 12, 8, 12 };
+        Data single { lengths, 2'000, 2'500, rng::Philox { 22 }, 0.1, 1 };
+        Data threaded { lengths, 2'000, 2'500, rng::Philox { 22 }, 0.1, 4 };
+
+        long mutated {};
+        long motif_bases {};
+        for (int i {}; i < 2'000; ++i) {
+            const auto seq { single.packed(i) };
+            const auto other { threaded.packed(i) };
+            for (int j {}; j < seq.size(); ++j) {
+                assert(seq[j] == other[j]);
+            }
+
+            std::vector<int> claimed(seq.size());
+            for (const auto& motif : single.sequences()[i].m_motifs) {
+                assert(static_cast<int>(motif.m_baseMotif.size()) == lengths[motif.m_motifId]);
+                for (int j {}; j < static_cast<int>(motif.m_motif.size()); ++j) {
+                    assert(utility::decode(seq[motif.m_startingIndex + j]) == motif.m_motif[j]);
+                    assert(++claimed[motif.m_startingIndex + j] == 1);
+                    mutated += motif.m_motif[j] != motif.m_baseMotif[j];
+                    ++motif_bases;
+                }
+            }
+        }
+        double rate { static_cast<double>(mutated) / motif_bases };
+        assert(rate > 0.09 && rate < 0.11);
+    }
+
+    /* Loads a small FASTA file with wrapped lines, CRLF endings and an 
+     * ambiguous base, which is skipped 
+     */
+    void test_load_fasta()
+    {
+        std::string path { std::filesystem::temp_directory_path() / "motif_finding_test.fasta" };
+        {
+            std::ofstream out { path };
+            out << ">first record\r\nACGT\r\nTTGA\r\n>second\nNCG\n>empty\n";
+        }
+
+        Data data { path, 2 };
+        std::remove(path.c_str());
+
+        assert(data.size() == std::make_pair(3, 8));
+        assert(data.sequences()[0].m_name == "first record");
+        assert(data.sequences()[2].m_name == "empty");
+
+        std::vector<std::string> expected { "ACGTTTGA", "CG", "" };
+        for (int i {}; i < 3; ++i) {
+            const auto seq { data.packed(i) };
+            assert(seq.size() == static_cast<int>(expected[i].size()));
+            for (int j {}; j < seq.size(); ++j) {
+                assert(utility::decode(seq[j]) == expected[i][j]);
+            }
+        }
+    }
+
+    /* Writes a generated dataset to a block store and reads it back */
+    void test_block_store()
+    {
+        std::string path { std::filesystem::temp_directory_path() / "motif_finding_test.blk" };
+        Data data { { 8, 12 }, 50, 300, rng::Philox { 7 } };
+        BlockStore::write(data, path, 1 << 10);
+
+        BlockStore store { path };
+        assert(store.num_sequences() == 50);
+        assert(store.num_blocks() > 1);
+        assert(store.max_length() == 300);
+        assert(store.motifs().size() == 2);
+
+        for (std::size_t b {}; b < store.num_blocks(); ++b) {
+            Block block { store.read_block(b) };
+            for (std::size_t i {}; i < block.num_sequences(); ++i) {
+                int s { static_cast<int>(block.first_sequence() + i) };
+                const auto expected { data.packed(s) };
+                const auto actual { block.sequence(i) };
+                assert(actual.size() == expected.size());
+                for (int j {}; j < actual.size(); ++j) {
+                    assert(actual[j] == expected[j]);
+                }
+
+                const auto& motifs { data.sequences()[s].m_motifs };
+                assert(block.motifs(i).size() == motifs.size());
+                for (std::size_t m {}; m < motifs.size(); ++m) {
+                    assert(block.motifs(i)[m].start == motifs[m].m_startingIndex);
+                    assert(block.motifs(i)[m].id == motifs[m].m_motifId);
+                    assert(store.motifs()[motifs[m].m_motifId] == motifs[m].m_baseMotif);
+                }
+            }
+        }
+
+        // a failed write is reported, and a truncated store neither opens
+        // nor leaks its descriptor
+        auto throws = [](auto&& f) {
+            try {
+                f();
+            } catch (const std::runtime_error&) {
+                return true;
+            }
+            return false;
+        };
+        assert(throws([&data]() { BlockStore::write(data, "/dev/full", 1 << 10); }));
+        std::filesystem::resize_file(path, sizeof(block_format::FileHeader) + 8);
+        auto open_fds = []() {
+            auto fds { std::filesystem::directory_iterator { "/proc/self/fd" } };
+            return std::distance(begin(fds), end(fds));
+        };
+        auto before { open_fds() };
+        assert(throws([&path]() { BlockStore { path }; }));
+        assert(open_fds() == before);
+        std::filesystem::remove(path);
+    }
+
+    /* A streaming sampler rejects settings that need the whole dataset and 
+     * stays within its memory budget, including the scoring buffers
+     */
+    void test_streaming()
+    {
+        std::string path { std::filesystem::temp_directory_path() / "motif_streaming_test.blk" };
+        Data data { { 8 }, 40, 200, rng::Philox { 8 } };
+        BlockStore::write(data, path, 1 << 10);
+        BlockStore store { path };
+
+        auto throws = [](auto&& f) {
+            try {
+                f();
+            } catch (const std::invalid_argument&) {
+                return true;
+            }
+            return false;
+        };
+        Streaming<float> sampler { store, 1 << 20, 20, rng::Philox { 9 } };
+        Mask mask { 40 };
+        assert(throws([&]() { sampler.set_mask(&mask); }));
+        assert(throws([&]() { sampler.set_background_order(1); }));
+        sampler.set_mask(nullptr);
+        sampler.set_background_order(0);
+        assert(sampler.resident_bytes() >= 2 * store.max_block_bytes() + 200 * (1 + 2 * sizeof(float)));
+        assert(sampler.resident_bytes(8) > sampler.resident_bytes());
+        assert(sampler.find_motifs(8, 0.1f).positions.size() == 40);
+
+        std::size_t single { sampler.resident_bytes() };
+        assert(throws([&]() { Streaming<float> { store, single - 1 }; }));
+        Streaming<float> tight { store, single, 20, rng::Philox { 9 } };
+        tight.set_pruning(2);
+        assert(tight.resident_bytes() > single);
+        tight.set_pruning(0);
+        tight.set_both_strands(true);
+        assert(tight.resident_bytes() > single);
+        assert(throws([&]() { (void)tight.find_motifs(8, 0.1f); }));
+        std::filesystem::remove(path);
+    }
+
+    /* Counts stay exact through updates and the lazy log-odds table matches
+     * a full recomputation
+     */
+    void test_pwm()
+    {
+        Data data { { 6 }, 20, 100, rng::Philox { 11 } };
+        Pwm<double> pwm { 6, 0.5, { std::log(0.25), std::log(0.25), std::log(0.25), std::log(0.25) } };
+        for (int i {}; i < 20; ++i) {
+            pwm.update(data.packed(i), i);
+        }
+        pwm.log_odds();
+
+        std::uint64_t version { pwm.version() };
+        pwm.update(data.packed(3), 3, false);
+        pwm.update(data.packed(3), 40);
+        assert(pwm.total() == 20);
+        for (int i {}; i < 6; ++i) {
+            assert(pwm.changed_since(i, version));
+            int column_total {};
+            for (int b {}; b < 4; ++b) {
+                column_total += pwm.count(i, b);
+                double expected { std::log(pwm.count(i, b) + 0.5) - std::log(0.25) };
+                assert(std::abs(pwm.log_odds()[4*i + b] - expected) < 1e-12);
+            }
+            assert(column_total == 20);
+        }
+        assert(!pwm.changed_since(0, pwm.version()));
+
+        pwm.update(data.packed(3), 40, false);
+        pwm.update(data.packed(3), 3);
+        Pwm<double> fresh { 6, 0.5, { std::log(0.25), std::log(0.25), std::log(0.25), std::log(0.25) } };
+        fresh.assign(pwm.counts(), pwm.total());
+        assert(fresh.log_odds() == pwm.log_odds());
+        assert(fresh.consensus() == pwm.consensus());
+    }
+
+    /* Policies stop where they say and keep no state between runs */
+    void test_stopping_policies()
+    {
+        Data data { { 8 }, 20, 200, rng::Philox { 5 } };
+        Serial<double> sampler { data, rng::Philox { 6 } };
+
+        sampler.set_policy(FixedIterations { 500 });
+        for (int run {}; run < 2; ++run) {
+            Result result { sampler.find_motifs(8, 0.1) };
+            assert(result.iterations == 500);
+            assert(!result.converged);
+        }
+
+        sampler.set_policy(Restarts { FixedIterations { 100 }, 3 });
+        assert(sampler.find_motifs(8, 0.1).iterations == 300);
+
+        StableConsensus stable { 10, 1'000 };
+        Progress progress { .iteration = 1, .stable_iterations = 10 };
+        assert(stable.stop(progress) && stable.converged());
+        stable.reset();
+        assert(!stable.converged());
+
+        int calls {};
+        LikelihoodPlateau plateau { 2, 1e-3, 1'000 };
+        progress = { .num_sequences = 4, .log_likelihood = [&calls]() { 
+            ++calls;
+            return 1.0;
+        } };
+        for (progress.iteration = 1; !plateau.stop(progress); ++progress.iteration) {
+        }
+        assert(plateau.converged());
+        assert(progress.iteration == 12 && calls == 3);
+    }
+
+    /* Every motif found after the first stays off the windows of those
+     * found before it
+     */
+    void test_multi_motif()
+    {
+        Mask mask { 1 };
+        mask.claim(0, 10, 5);
+        assert(mask.masked(0, 6, 5) && mask.masked(0, 14, 3));
+        assert(!mask.masked(0, 5, 5) && !mask.masked(0, 15, 3));
+        assert(mask.has_free_window(0, 1, 5));
+        mask.claim(0, 0, 6);
+        assert(!mask.has_free_window(0, 15, 5) && mask.has_free_window(0, 16, 5));
+
+        Data data { { 8, 8, 6 }, 15, 200, rng::Philox { 9 } };
+        Serial<double> sampler { data, rng::Philox { 10 } };
+        sampler.set_policy(FixedIterations { 300 });
+        MultiMotif<double> driver { data, sampler };
+
+        std::vector<int> lengths { 6, 8, 8 };
+        std::vector<Result> results { driver.find_motifs(lengths, 0.1) };
+        assert(results.size() == 3);
+        for (int i {}; i < 15; ++i) {
+            for (int a {}; a < 3; ++a) {
+                for (int b { a + 1 }; b < 3; ++b) {
+                    int pa { results[a].positions[i] };
+                    int pb { results[b].positions[i] };
+                    assert(pa + lengths[a] <= pb || pb + lengths[b] <= pa);
+                }
+            }
+        }
+
+        // any first motif leaves no window of 6 free in 12 bases
+        Data crowded { { 6 }, 4, 12, rng::Philox { 11 } };
+        Serial<double> crowded_sampler { crowded, rng::Philox { 12 } };
+        crowded_sampler.set_policy(FixedIterations { 50 });
+        MultiMotif<double> crowded_driver { crowded, crowded_sampler };
+        bool threw {};
+        try {
+            crowded_driver.find_motifs({ 6, 6 }, 0.1);
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    /* A seed names one run: the same Philox seed gives the same chain, 
+     * while split streams neither repeat nor depend on the parent's draws
+     */
+    void test_seeded_samplers()
+    {
+        rng::Philox gen { 31 };
+        rng::Philox fresh_split { gen.split(0) };
+        (void)gen();
+        rng::Philox drawn_split { gen.split(0) };
+        rng::Philox other_split { gen.split(1) };
+        int same {};
+        for (int i {}; i < 1000; ++i) {
+            auto value { fresh_split() };
+            assert(drawn_split() == value);
+            same += other_split() == value;
+        }
+        assert(same < 2);
+
+        Data data { { 8 }, 20, 200, rng::Philox { 30 } };
+        auto run = [&data](rng::Philox chain_gen) {
+            Serial<double> sampler { data, chain_gen };
+            sampler.set_policy(FixedIterations { 300 });
+            return sampler.find_motifs(8, 0.1).positions;
+        };
+        assert(run(rng::Philox { 32 }) == run(rng::Philox { 32 }));
+        assert(run(rng::Philox { 32 }.split(0)) == run(rng::Philox { 32 }.split(0)));
+        assert(run(rng::Philox { 32 }.split(0)) != run(rng::Philox { 32 }.split(1)));
+    }
+
+    /* MultiStart needs a chain, reruns the same chains from the same seed
+     * on any number of threads, and keeps the most likely of them
+     */
+    void test_multi_start()
+    {
+        Data data { { 8 }, 15, 200, rng::Philox { 33 } };
+        bool threw {};
+        try {
+            MultiStart<double> empty { data, 0 };
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        assert(threw);
+
+        rng::Philox gen { 34 };
+        MultiStart<double> sampler { data, 4, 2, FixedIterations { 200 }, gen };
+        MultiStart<double> rerun { data, 4, 3, FixedIterations { 200 }, gen };
+        Result result { sampler.find_motifs(8, 0.1) };
+        assert(rerun.find_motifs(8, 0.1).positions == result.positions);
+
+        double best { std::numeric_limits<double>::lowest() };
+        for (int i {}; i < 4; ++i) {
+            Serial<double> chain { data, gen.split(i) };
+            chain.set_policy(FixedIterations { 200 });
+            best = std::max(best, chain.find_motifs(8, 0.1).log_likelihood);
+        }
+        assert(result.log_likelihood == best);
+    }
+
+    /* Samplers built from a DataHandle keep the dataset alive, and their
+     * chains share it rather than copying it
+     */
+    void test_shared_data()
+    {
+        DataHandle data { std::make_shared<const Data>(std::vector<int> { 8 }, 10, 200, rng::Philox { 23 }) };
+        std::weak_ptr<const Data> weak { data };
+        const std::uint64_t* words { data->words().data() };
+
+        MultiStart<double> sampler { data, 3, 2, FixedIterations { 50 }, rng::Philox { 24 } };
+        data.reset();
+        assert(!weak.expired() && weak.use_count() == 1);
+        assert(weak.lock()->words().data() == words);
+
+        Result result { sampler.find_motifs(8, 0.1) };
+        assert(result.positions.size() == 10);
+        assert(weak.use_count() == 1);
+    }
+
+    /* Exposes GibbsSampler's scoring for test_parallel_score */
+    class ScoreProbe : public Serial<double>
+    {
+        public:
+            using Serial<double>::Serial;
+
+            std::vector<double> score(int k, int withheld)
+            {
+                Pwm<double> pwm { this->init_pwm(m_positions, k, 0.1) };
+                return GibbsSampler<double>::score(pwm, withheld);
+            }
+
+            const PruneReport& report() const { return this->prune_report(); }
+
+            std::vector<int> m_positions;
+    };
+
+    /* Both-strand scoring keeps the forward windows' relative weights and 
+     * a chain on both strands reports a strand per position
+     */
+    void test_both_strand_sampler()
+    {
+        Data data { { 10 }, 6, 300, rng::Philox { 17 } };
+        ScoreProbe probe { data, rng::Philox { 18 } };
+        probe.m_positions = { 1, 2, 3, 4, 5, 6 };
+        std::vector<double> forward { probe.score(10, 0) };
+
+        probe.set_both_strands(true);
+        std::vector<double> both { probe.score(10, 0) };
+        assert(both.size() == 2 * forward.size());
+
+        double forward_mass { std::accumulate(begin(both), begin(both) + forward.size(), 0.0) };
+        assert(forward_mass > 0 && forward_mass < 1);
+        for (std::size_t i {}; i < forward.size(); ++i) {
+            assert(std::abs(both[i] / forward_mass - forward[i]) <= 1e-9 * forward[i]);
+        }
+
+        Serial<double> sampler { data, rng::Philox { 19 } };
+        sampler.set_policy(FixedIterations { 200 });
+        sampler.set_both_strands(true);
+        Result result { sampler.find_motifs(10, 0.1) };
+        assert(result.reverse_strand.size() == result.positions.size());
+        for (int position : result.positions) {
+            assert(position >= 0 && position + 10 <= 300);
+        }
+    }
+
+    /* Chunked scoring on a pool matches the single-threaded path */
+    void test_parallel_score()
+    {
+        Data data { { 12 }, 4, 20'000, rng::Philox { 13 } };
+        ScoreProbe probe { data, rng::Philox { 14 } };
+        probe.m_positions = { 5, 500, 5'000, 15'000 };
+
+        std::vector<double> expected { probe.score(12, 2) };
+
+        ThreadPool pool { 3 };
+        probe.set_score_pool(&pool, 1'000);
+        std::vector<double> actual { probe.score(12, 2) };
+
+        assert(actual.size() == expected.size());
+        double total {};
+        for (std::size_t i {}; i < actual.size(); ++i) {
+            assert(std::abs(actual[i] - expected[i]) <= 1e-9 * expected[i]);
+            total += actual[i];
+        }
+        assert(std::abs(total - 1.0) < 1e-9);
+    }
+
+    /* Pruned windows really score below the cutoff, kept windows are exact,
+     * and the reported error bounds the actual total variation distance
+     */
+    void test_pruned_score()
+    {
+        Data data { { 16 }, 4, 5'000, rng::Philox { 15 } };
+        ScoreProbe probe { data, rng::Philox { 16 } };
+        probe.m_positions = { 5, 50, 500, 4'000 };
+        std::vector<double> exact { probe.score(16, 1) };
+
+        probe.set_pruning(8);
+        std::vector<double> pruned { probe.score(16, 1) };
+        double max_error { probe.report().max_error };
+        assert(probe.report().pruned > 0);
+
+        double kept_mass {};
+        for (std::size_t i {}; i < exact.size(); ++i) {
+            if (pruned[i] > 0) {
+                kept_mass += exact[i];
+            }
+        }
+        double distance {};
+        for (std::size_t i {}; i < exact.size(); ++i) {
+            double expected { pruned[i] > 0 ? exact[i] / kept_mass : 0 };
+            assert(std::abs(pruned[i] - expected) <= 1e-9 * expected + 1e-300);
+            distance += std::abs(pruned[i] - exact[i]) / 2;
+        }
+        assert(distance <= max_error + 1e-12);
+    }
+
+    /* Background counts are exact, and an order-m background shifts each 
+     * window's log score by the difference between its base-frequency 
+     * and context probabilities
+     */
+    void test_background()
+    {
+        Data data { { 10 }, 5, 301, rng::Philox { 20 } };
+        int order { 2 };
+        const Background& model { data.background(order) };
+        assert(&model == &data.background(order));
+
+        std::array<std::uint64_t, 4> bases {};
+        std::vector<std::uint64_t> contexts(std::size_t { 4 } << (2 * order));
+        for (int i {}; i < data.size().first; ++i) {
+            const auto seq { data.packed(i) };
+            for (int j {}; j < seq.size(); ++j) {
+                ++bases[seq[j]];
+                if (j >= order) {
+                    ++contexts[16 * seq[j-2] + 4 * seq[j-1] + seq[j]];
+                }
+            }
+        }
+        assert(model.base_counts() == bases);
+        assert(model.context_counts() == contexts);
+        assert(data.background().base_counts() == bases);
+
+        double sum {};
+        for (int b {}; b < 4; ++b) {
+            sum += std::exp(model.log_conditional()[4 + b]);
+        }
+        assert(std::abs(sum - 1) < 1e-12);
+
+        ScoreProbe probe { data, rng::Philox { 21 } };
+        probe.m_positions = { 1, 2, 3, 4, 5 };
+        std::vector<double> flat { probe.score(10, 0) };
+        probe.set_background_order(order);
+        std::vector<double> markov { probe.score(10, 0) };
+
+        const auto seq { data.packed(0) };
+        auto freqs { data.background().frequencies() };
+        auto shift = [&](int position) {
+            double result {};
+            for (int j { position }; j < position + 10; ++j) {
+                double context { j < order ? std::log(freqs[seq[j]]) : 
+                    model.log_conditional()[16 * seq[j-2] + 4 * seq[j-1] + seq[j]] };
+                result += std::log(freqs[seq[j]]) - context;
+            }
+            return result;
+        };
+        for (int i { 1 }; i < static_cast<int>(flat.size()); ++i) {
+            double expected { std::log(flat[i] / flat[0]) + shift(i) - shift(0) };
+            assert(std::abs(std::log(markov[i] / markov[0]) - expected) < 1e-9);
+        }
+    }
+
+    /* The server answers every job, bad ones with an error, and a job 
+     * gives the same result as a sampler run with its seed 
+     */
+    void test_job_server()
+    {
+        auto data { std::make_shared<const Data>(std::vector<int> { 10 }, 8, 200, rng::Philox { 22 }) };
+        JobServer server { data, 10, 2 };
+
+        std::istringstream in { 
+            "id=a seed=5 iterations=300\n"
+            "\n"
+            "# comment\n"
+            "id=b seed=6 chains=3 k=8\n"
+            "id=c k=500\n"
+            "id=d colour=blue\n" 
+            "id=e chains=2000000000\n"
+        };
+        std::ostringstream out {};
+        server.serve(in, out);
+
+        std::vector<std::string> lines {};
+        std::istringstream answers { out.str() };
+        for (std::string line {}; std::getline(answers, line); ) {
+            lines.push_back(line);
+        }
+        assert(lines.size() == 5);
+        auto answer = [&lines](const std::string& id) {
+            auto it { std::find_if(begin(lines), end(lines), [&id](const std::string& line) {
+                return line.starts_with("{\"id\": \"" + id + "\"");
+            }) };
+            assert(it != end(lines));
+            return *it;
+        };
+        assert(answer("b").find("\"chains\": 3") != std::string::npos);
+        assert(answer("c").find("\"error\"") != std::string::npos);
+        assert(answer("d").find("unknown job key colour") != std::string::npos);
+        assert(answer("e").find("out of range") != std::string::npos);
+
+        Serial<float> sampler { data, rng::Philox { 5, rng::sampler_stream } };
+        sampler.set_policy(StableConsensus { 200, 300 });
+        std::ostringstream expected {};
+        write_json(expected, sampler.find_motifs(10, 0.1f));
+        std::string a { answer("a") };
+        assert(a.ends_with(expected.str().substr(1)));
+    }
+
+    /* Sweeps start with the costliest cells, and every run gives the same 
+     * result however many threads share the sweep
+     */
+    void test_sweep()
+    {
+        std::vector<SweepCell> cells { sweep_grid({ 1, 2 }, { 8 }, { 4 }, { 100, 300 }) };
+        assert(cells.size() == 4);
+        std::vector<int> order { sweep_schedule(cells, 2) };
+        assert(order.size() == 8);
+        assert(order[0] / 2 == 3 && order[1] / 2 == 3);
+        for (std::size_t i { 1 }; i < order.size(); ++i) {
+            assert(cells[order[i-1] / 2].cost() >= cells[order[i] / 2].cost());
+        }
+
+        int finished {};
+        auto serial { run_sweep(cells, 2, FixedIterations { 50 }, 7, 1) };
+        auto parallel { run_sweep(cells, 2, FixedIterations { 50 }, 7, 3, 
+            [&finished](const SweepRun&) { ++finished; }) };
+        assert(finished == 8);
+        assert(serial.size() == 8 && parallel.size() == 8);
+        for (std::size_t i {}; i < serial.size(); ++i) {
+            assert(serial[i].rep == static_cast<int>(i % 2));
+            assert(serial[i].cell.sequence_length == parallel[i].cell.sequence_length);
+            assert(serial[i].iterations == 50 && parallel[i].iterations == 50);
+            assert(serial[i].num_correct == parallel[i].num_correct);
+        }
+
+        std::ostringstream csv {};
+        write_sweep_csv(csv, serial);
+        std::string rows { csv.str() };
+        assert(std::count(begin(rows), end(rows), '\n') == 9);
+    }
+
+    /* One Hogwild thread never reads stale counts; several still count
+     * every iteration once and find the motif
+     */
+    void test_hogwild()
+    {
+        Data data { { 12 }, 60, 300, rng::Philox { 23 } };
+
+        Hogwild<float> single { data, 1, rng::Philox { 24 } };
+        single.set_policy(FixedIterations { 600 });
+        Result alone { single.find_motifs(12, 0.1f) };
+        assert(alone.iterations == 600);
+        assert(single.staleness().updates == 600);
+        assert(single.staleness().mean == 0 && single.staleness().max == 0);
+
+        Hogwild<float> sampler { data, 4, rng::Philox { 25 } };
+        sampler.set_policy(FixedIterations { 3'000 });
+        Result result { sampler.find_motifs(12, 0.1f) };
+        assert(result.iterations == 3'000);
+        assert(sampler.staleness().updates >= 3'000);
+        assert(result.positions.size() == 60);
+        for (int position : result.positions) {
+            assert(position >= 0 && position < 300 - 12);
+        }
+        assert(result.num_correct >= 48);
+    }
+}
+
+int main()
+{
+    test_score_windows<float>();
+    test_score_windows<double>();
+    test_score_windows<long double>();
+    test_load_fasta();
+    test_block_store();
+    test_streaming();
+    test_pwm();
+    test_stopping_policies();
+    test_multi_motif();
+    test_parallel_score();
+    test_pruned_score();
+    test_both_strands<float>();
+    test_both_strands<double>();
+    test_both_strand_sampler();
+    test_generate_data();
+    test_seeded_samplers();
+    test_multi_start();
+    test_shared_data();
+    test_data_cache();
+    test_background();
+    test_job_server();
+    test_sweep();
+    test_hogwild();
+    std::cout << "all tests passed" << std::endl;
+
+    return 0;
+}
+
 
 // auto time_function = [](auto&& func) -> double {
 //     // collect min, max, average times 
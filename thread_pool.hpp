@@ -0,0 +1,86 @@
+#pragma once
+
+#include "algorithm"
+#include "condition_variable"
+#include "functional"
+#include "future"
+#include "memory"
+#include "mutex"
+#include "queue"
+#include "thread"
+#include "type_traits"
+#include "vector"
+
+/* Fixed-size pool of worker threads consuming a FIFO task queue */
+class ThreadPool
+{
+    public:
+        /* num_threads : number of workers; 0 uses one per hardware thread */
+        explicit ThreadPool(unsigned num_threads = 0)
+        {
+            if (num_threads == 0) {
+                num_threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            m_workers.reserve(num_threads);
+            for (unsigned i {}; i < num_threads; ++i) {
+                m_workers.emplace_back([this]() { this->work(); });
+            }
+        }
+
+        /* Finishes every queued task before joining the workers */
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard lock { m_mutex };
+                m_stopping = true;
+            }
+            m_ready.notify_all();
+            for (auto& worker : m_workers) {
+                worker.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /* Queues func and returns a future for its result */
+        template <typename F>
+        std::future<std::invoke_result_t<F>> submit(F&& func)
+        {
+            using R = std::invoke_result_t<F>;
+            auto task { std::make_shared<std::packaged_task<R()>>(std::forward<F>(func)) };
+            auto result { task->get_future() };
+            {
+                std::lock_guard lock { m_mutex };
+                m_tasks.emplace([task]() { (*task)(); });
+            }
+            m_ready.notify_one();
+            return result;
+        }
+
+        unsigned size() const { return m_workers.size(); }
+
+    private:
+        std::vector<std::thread> m_workers;
+        std::queue<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_ready;
+        bool m_stopping {};
+
+        void work()
+        {
+            while (true) {
+                std::function<void()> task {};
+                {
+                    std::unique_lock lock { m_mutex };
+                    m_ready.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+                    if (m_tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(m_tasks.front());
+                    m_tasks.pop();
+                }
+                task();
+            }
+        }
+};
@@ -1,46 +1,36 @@
-#include "random"
-#include "set"
-#include "unordered_map"
+#include "algorithm"
+#include "stdexcept"
+#include "string"
+#include "utility"
 #include "vector"
 
 #include "utility.hpp"
 
-#include "iostream"
-
-std::vector<int> utility::rand_indices(int max, int width, int count) 
+std::vector<int> utility::rand_indices(rng::Philox& gen, int max, int width, 
+    int count) 
 {
-    std::random_device rand_device {};
-    std::mt19937 num_gen { rand_device() };
-    
-    std::vector<int> result {};
-    std::uniform_int_distribution<int> dist(0, max-width);
-    std::set<int> positions {};
+    // count windows take count*width of [0, max); the slack left over is 
+    // split into gaps by count sorted draws, so no draw is ever rejected
+    int slack { max - count * width };
+    if (slack < 0) {
+        throw std::invalid_argument { 
+            std::to_string(count) + " windows of width " + std::to_string(width) + 
+            " do not fit in " + std::to_string(max) 
+        };
+    }
 
+    std::vector<int> result(count);
+    for (auto& index : result) {
+        index = gen.below(slack + 1);
+    }
+    std::sort(begin(result), end(result));
     for (int i {}; i < count; ++i) {
-        bool valid;
-        std::vector<int> tmp {};
-        int pos;
-
-        do {  // WARNING: may cause an infinite loop if too many motifs 
-
+        result[i] += i * width;
+    }
 
-            valid = true;
-            pos = dist(num_gen);
-            for (int i { pos }; i < pos + width; ++i) {
-                if (positions.count(i) || i == max) { 
-                    valid = false; 
-                    tmp.clear();
-					break;
-                } else {
-					tmp.push_back(i);
-				}
-            } 
-        } while (!valid);
-        
-        result.push_back(pos);
-        positions.insert(begin(tmp), end(tmp));                    
+    // callers pair index i with item i, so the order must be random too
+    for (int i { count - 1 }; i > 0; --i) {
+        std::swap(result[i], result[gen.below(i + 1)]);
     }
-    
     return result;
 }
-
@@ -1,42 +1,60 @@
 #pragma once
 
-#include "random"
-#include "unordered_map"
+#include "array"
+#include "cstdint"
 #include "vector"
 
+#include "rng.hpp"
+
 namespace utility {
-    namespace {
-        std::random_device rand_device {};
-		std::mt19937 num_gen { rand_device() };
-        std::discrete_distribution<> discrete_distr { 25, 25, 25, 25 };
+    /* Encoding returned for any char outside {A, C, T, G} (either case) */
+    inline constexpr std::uint8_t invalid_nucleotide { 4 };
+
+    /* 256-entry char -> 2-bit code table; A=0, C=1, T=2, G=3 */
+    inline constexpr std::array<std::uint8_t, 256> encoding_table { []() {
+        std::array<std::uint8_t, 256> table {};
+        table.fill(invalid_nucleotide);
+        table['A'] = table['a'] = 0;
+        table['C'] = table['c'] = 1;
+        table['T'] = table['t'] = 2;
+        table['G'] = table['g'] = 3;
+        return table;
+    }() };
+
+    inline constexpr std::array<char, 4> decoding_table { 'A', 'C', 'T', 'G' };
 
-        std::unordered_map<int, char> nucleotide_map =  { {0, 'A'}, {1, 'C'}, {2, 'T'}, {3, 'G'} };
-        std::unordered_map<char, int> encoding_map =  { {'A', 0}, {'C', 1}, {'T', 2}, {'G', 3} };
-    }
-   
 	/* c must be in {A, C, T, G} */
     inline int encode(char c)
     {
-        return encoding_map[c];
+        return encoding_table[static_cast<unsigned char>(c)];
     }
 
     /* i must be in {0, 1, 2, 3} */
     inline char decode(int i)
     {
-        return nucleotide_map[i];
+        return decoding_table[i];
     }
    
+    /* Encoding of the complementary base (A-T, C-G) */
+    inline constexpr int complement(int i)
+    {
+        return i ^ 2;
+    }
+
     /* Returns a random char in {A, C, T, G}*/
-    inline char rand_nucleotide()
+    inline char rand_nucleotide(rng::Philox& gen)
     {
-        return nucleotide_map[discrete_distr(num_gen)];
+        return decode(gen.below(4));
     }
 
-    /* Returns count random indices within the range [0, max-width]
+    /* Returns count random indices within the range [0, max-width], in 
+     * random order, in O(count log count) without rejection sampling
      * max: selected random index from the uniform distribution [0, max)
      * count: number of indices to return
      * width: pseudo-length of index, such that if count > 1, they are 
      * guaranteed to be width indices away from each over to prevent overlap
+     * Throws std::invalid_argument if count windows of width exceed max.
      */ 
-    std::vector<int> rand_indices(int max, int width = 1, int count = 1);
+    std::vector<int> rand_indices(rng::Philox& gen, int max, int width = 1, 
+        int count = 1);
 }